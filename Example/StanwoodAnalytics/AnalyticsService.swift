@@ -26,7 +26,7 @@ struct CustomMapFunction: MapFunction {
 
     public func mapScreenName(parameters: TrackingParameters) -> String? {
 
-        if parameters.eventName.lowercased() == StanwoodAnalytics.TrackingEvent.viewItem.rawValue.lowercased() {
+        if parameters.isEvent(.viewItem) {
             return parameters.name
         }
         return nil
@@ -163,7 +163,7 @@ struct AnalyticsService {
         guard let analytics = AnalyticsService.analytics else { return }
         var trackerKeys = TrackerKeys()
         trackerKeys.customKeys = ["resortId": String(describing: resortId)]
-        trackerKeys.customKeys["resortName"] = resortName
+        trackerKeys[customKey: "resortName"] = resortName
         analytics.track(trackerKeys: trackerKeys)
     }
 
@@ -171,14 +171,14 @@ struct AnalyticsService {
         guard let analytics = AnalyticsService.analytics else { return }
         var trackerKeys = TrackerKeys()
         if let identifier = identifier {
-            trackerKeys.customKeys[StanwoodAnalytics.Keys.identifier] = identifier
+            trackerKeys[customKey: StanwoodAnalytics.Keys.identifier] = identifier
         }
         if let email = email {
-            trackerKeys.customKeys[StanwoodAnalytics.Keys.email] = email
+            trackerKeys[customKey: StanwoodAnalytics.Keys.email] = email
         }
 
         if let userName = userName {
-            trackerKeys.customKeys[StanwoodAnalytics.Keys.userName] = userName
+            trackerKeys[customKey: StanwoodAnalytics.Keys.userName] = userName
         }
 
         analytics.track(trackerKeys: trackerKeys)
@@ -0,0 +1,175 @@
+import XCTest
+import StanwoodAnalytics
+
+/// Benchmarks of the tracker adapters with stand-ins for the vendor SDKs.
+///
+/// The trackers are called directly, without StanwoodAnalytics, so the results are the cost of the adapters
+/// alone. Each benchmark also reports the vendor calls per event.
+class AdapterBenchmarks: XCTestCase {
+
+    /// The numbers of custom values of the tracked parameters.
+    private let customValueCounts = [0, 4, 16]
+
+    /// The events of each run.
+    private let events = 2_000
+
+    private let error = NSError(domain: "io.stanwood.benchmark", code: 42, userInfo: [NSLocalizedDescriptionKey: "Benchmark error"])
+
+    // MARK: Firebase
+
+    func testFirebaseTracker() {
+        let analytics = FirebaseAnalyticsStandIn()
+        let tracker = FirebaseTracker.FirebaseBuilder(context: UIApplication.shared).set(analytics: analytics).build()
+
+        for customValueCount in customValueCounts {
+            let parameters = TrackingParameters.benchmark(customValues: customValueCount)
+            let calls = benchmarkAdapter("firebase.event.\(customValueCount)values", calls: { analytics.calls }) {
+                tracker.track(event: PreparedEvent(parameters))
+            }
+            XCTAssertEqual(calls, 1)
+        }
+
+        let screenKeys = TrackerKeys.screen()
+        XCTAssertEqual(benchmarkAdapter("firebase.screen", calls: { analytics.calls }) { tracker.track(trackerKeys: screenKeys) }, 1)
+        XCTAssertEqual(benchmarkAdapter("firebase.error", calls: { analytics.calls }) { tracker.track(error: error) }, 1)
+    }
+
+    // MARK: Mixpanel
+
+    func testMixpanelTracker() {
+        let mixpanel = MixpanelStandIn()
+        let tracker = MixpanelTracker.MixpanelBuilder(context: UIApplication.shared, key: "stand-in").set(mixpanel: mixpanel).build()
+
+        for customValueCount in customValueCounts {
+            let parameters = TrackingParameters.benchmark(customValues: customValueCount)
+            let calls = benchmarkAdapter("mixpanel.event.\(customValueCount)values", calls: { mixpanel.calls }) {
+                tracker.track(event: PreparedEvent(parameters))
+            }
+            XCTAssertEqual(calls, 1)
+        }
+
+        for customValueCount in customValueCounts {
+            let trackerKeys = TrackerKeys.user(customValues: customValueCount)
+            let calls = benchmarkAdapter("mixpanel.keys.\(customValueCount)values", calls: { mixpanel.calls }) {
+                tracker.track(trackerKeys: trackerKeys)
+            }
+            // The identifier, the email and one people property per custom value.
+            XCTAssertEqual(calls, Double(2 + customValueCount))
+        }
+    }
+
+    // MARK: Google Analytics
+
+    func testGoogleAnalyticsTracker() {
+        let googleAnalytics = GoogleAnalyticsStandIn()
+        let tracker = GoogleAnalyticsTracker.GoogleAnalyticsBuilder(context: UIApplication.shared, key: "UA-0000000-0")
+            .set(googleAnalytics: googleAnalytics)
+            .build()
+        let hits = { googleAnalytics.tracker.hits }
+
+        for customValueCount in customValueCounts {
+            let screenView = TrackingParameters.benchmark(customValues: customValueCount)
+            let event = TrackingParameters.benchmark(eventName: StanwoodAnalytics.TrackingEvent.purchase.rawValue, customValues: customValueCount)
+
+            // Each screen view is sent twice, once with and once without the custom dimension in the hit.
+            XCTAssertEqual(benchmarkAdapter("googleAnalytics.screenView.\(customValueCount)values", calls: hits) {
+                tracker.track(event: PreparedEvent(screenView))
+            }, 2)
+            XCTAssertEqual(benchmarkAdapter("googleAnalytics.event.\(customValueCount)values", calls: hits) {
+                tracker.track(event: PreparedEvent(event))
+            }, 1)
+        }
+
+        XCTAssertEqual(benchmarkAdapter("googleAnalytics.error", calls: hits) { tracker.track(error: error) }, 1)
+    }
+
+    // MARK: Crashlytics
+
+    func testCrashlyticsTracker() {
+        let crashlytics = CrashlyticsStandIn()
+        let tracker = CrashlyticsTracker.CrashlyticsBuilder(context: UIApplication.shared, key: nil).set(crashlytics: crashlytics).build()
+
+        for customValueCount in customValueCounts {
+            let parameters = TrackingParameters.benchmark(customValues: customValueCount)
+            // Events are only logged in Debug and Stage builds.
+            benchmarkAdapter("crashlytics.event.\(customValueCount)values", calls: { crashlytics.calls }) {
+                tracker.track(event: PreparedEvent(parameters))
+            }
+        }
+
+        for customValueCount in customValueCounts {
+            let trackerKeys = TrackerKeys.user(customValues: customValueCount)
+            let calls = benchmarkAdapter("crashlytics.keys.\(customValueCount)values", calls: { crashlytics.calls }) {
+                tracker.track(trackerKeys: trackerKeys)
+            }
+            XCTAssertEqual(calls, Double(2 + customValueCount))
+        }
+
+        XCTAssertEqual(benchmarkAdapter("crashlytics.error", calls: { crashlytics.calls }) { tracker.track(error: error) }, 1)
+    }
+
+    // MARK: TestFairy
+
+    func testTestFairyTracker() {
+        let testFairy = TestFairyStandIn()
+        let tracker = TestFairyTracker.TestFairyBuilder(context: UIApplication.shared, key: "stand-in").set(testFairy: testFairy).build()
+
+        for customValueCount in customValueCounts {
+            let parameters = TrackingParameters.benchmark(customValues: customValueCount)
+            let calls = benchmarkAdapter("testFairy.event.\(customValueCount)values", calls: { testFairy.calls }) {
+                tracker.track(event: PreparedEvent(parameters))
+            }
+            XCTAssertEqual(calls, 1)
+        }
+
+        let trackerKeys = TrackerKeys.user(customValues: 4)
+        XCTAssertEqual(benchmarkAdapter("testFairy.keys", calls: { testFairy.calls }) { tracker.track(trackerKeys: trackerKeys) }, 1)
+    }
+
+    // MARK: Helpers
+
+    /// Benchmarks one tracker operation and returns the vendor calls it makes.
+    ///
+    /// - Parameters:
+    ///   - name: The name of the benchmark.
+    ///   - calls: Reads the count of the stand-in.
+    ///   - operation: One operation on the tracker.
+    /// - Returns: The vendor calls per operation.
+    @discardableResult
+    private func benchmarkAdapter(_ name: String, calls: () -> Int, file: StaticString = #file, line: UInt = #line, _ operation: () -> Void) -> Double {
+        let callsBefore = calls()
+        operation()
+        let callsPerEvent = Double(calls() - callsBefore)
+
+        let events = self.events
+        benchmark(name, events: events, file: file, line: line) {
+            for _ in 0..<events {
+                operation()
+            }
+        }
+        print("Benchmark \(name): \(callsPerEvent) vendor calls/event")
+        return callsPerEvent
+    }
+}
+
+extension TrackerKeys {
+
+    /// The keys tracked by trackScreen(name:className:).
+    static func screen() -> TrackerKeys {
+        var trackerKeys = TrackerKeys()
+        trackerKeys.set("ProductDetail", forKey: StanwoodAnalytics.Keys.screenName)
+        trackerKeys.set("ProductViewController", forKey: StanwoodAnalytics.Keys.screenClass)
+        return trackerKeys
+    }
+
+    /// The user identifier and email, and the given number of custom values.
+    static func user(customValues count: Int) -> TrackerKeys {
+        var trackerKeys = TrackerKeys()
+        trackerKeys.set("user-4711", forKey: StanwoodAnalytics.Keys.identifier)
+        trackerKeys.set("user@example.com", forKey: StanwoodAnalytics.Keys.email)
+        for index in 0..<count {
+            trackerKeys.set(index, forKey: "key_\(index)")
+        }
+        return trackerKeys
+    }
+}
@@ -0,0 +1,154 @@
+import XCTest
+import StanwoodAnalytics
+
+/// The heap allocations of one call.
+struct AllocationBudget: Codable {
+    let allocationsPerCall: Double
+    let bytesPerCall: Double
+}
+
+/// The recorded budgets, in Baselines/AllocationBudgets.json. The allocations do not depend on the device,
+/// so the budgets are recorded once for all of them.
+let allocationBudgets = BaselineStore<AllocationBudget>(fileName: "AllocationBudgets.json", perDevice: false)
+
+/// A typed event, as tracked with StanwoodAnalytics.track(event:).
+private struct PurchaseEvent: TrackableEvent {
+    static let eventName = StanwoodAnalytics.TrackingEvent.purchase.rawValue
+
+    let productId: String
+    let price: Double
+    let quantity: Int
+
+    func encode(to encoder: inout EventEncoder) {
+        encoder.encode(productId, for: \.itemId)
+        encoder.encode(price, forKey: "price")
+        encoder.encode(quantity, forKey: "quantity")
+    }
+}
+
+/// Allocation budgets of the public tracking entry points.
+///
+/// Each test counts the heap allocations and the bytes of a call, including the delivery to two stub trackers, and
+/// fails when a call goes over its recorded budget. A call without a budget is reported and not checked. When a change
+/// is meant to allocate more, record the budgets again with STANWOOD_BENCHMARK_RECORD=1 and commit them with the change.
+class AllocationBudgetTests: XCTestCase {
+
+    /// The calls measured for each budget.
+    private let calls = 1_000
+
+    private var analytics: StanwoodAnalytics!
+
+    override func setUp() {
+        super.setUp()
+        analytics = StanwoodAnalytics.stubbed(trackers: 2, capacity: calls).0
+    }
+
+    override func tearDown() {
+        AllocationCounter.uninstall()
+        analytics = nil
+        DataStore.setTracking(enabled: true)
+        super.tearDown()
+    }
+
+    func testTrackParameters() {
+        for customValueCount in [0, 4, 16] {
+            let parameters = TrackingParameters.benchmark(customValues: customValueCount)
+            checkBudget("track.\(customValueCount)values") {
+                analytics.track(trackingParameters: parameters)
+            }
+        }
+    }
+
+    func testTrackTypedEvent() {
+        let event = PurchaseEvent(productId: "item-4711", price: 9.99, quantity: 2)
+        checkBudget("trackTypedEvent") {
+            analytics.track(event: event)
+        }
+    }
+
+    func testTrackKeys() {
+        let trackerKeys = TrackerKeys.user(customValues: 4)
+        checkBudget("trackKeys.4values") {
+            analytics.track(trackerKeys: trackerKeys)
+        }
+    }
+
+    func testTrackScreen() {
+        checkBudget("trackScreen") {
+            analytics.trackScreen(name: "ProductDetail", className: "ProductViewController")
+        }
+    }
+
+    func testTrackError() {
+        let error = NSError(domain: "io.stanwood.budget", code: 42, userInfo: [NSLocalizedDescriptionKey: "Budget error"])
+        checkBudget("trackError") {
+            analytics.track(error: error)
+        }
+    }
+
+    func testSetTracking() {
+        checkBudget("setTracking") {
+            analytics.setTracking(enabled: true)
+        }
+    }
+
+    func testPayloads() {
+        let parameters = TrackingParameters.benchmark(customValues: 4)
+        let trackerKeys = TrackerKeys.user(customValues: 4)
+
+        checkBudget("payload.4values") {
+            blackHole(parameters.payload())
+        }
+        checkBudget("debugInfo.4values") {
+            blackHole(parameters.debugInfo())
+        }
+        checkBudget("trackerKeysPayload.4values") {
+            blackHole(trackerKeys.payload())
+        }
+    }
+
+    // MARK: Helpers
+
+    /// Counts the allocations of a call and compares them with the recorded budget, when there is one.
+    ///
+    /// - Parameters:
+    ///   - name: The name of the budget.
+    ///   - call: One call of the entry point.
+    private func checkBudget(_ name: String, file: StaticString = #file, line: UInt = #line, _ call: () -> Void) {
+        AllocationCounter.install()
+        guard AllocationCounter.isAvailable else {
+            print("StanwoodAnalytics Warning: The allocation budget \(name) is not checked.")
+            return
+        }
+
+        // The first call fills the caches and grows the buffers.
+        call()
+        analytics.flush()
+
+        let before = AllocationCounter.counts
+        for _ in 0..<calls {
+            call()
+        }
+        analytics.flush()
+        let after = AllocationCounter.counts
+
+        let budget = AllocationBudget(allocationsPerCall: Double(after.allocations - before.allocations) / Double(calls),
+                                      bytesPerCall: Double(after.bytes - before.bytes) / Double(calls))
+        let recorded = allocationBudgets.baseline(for: name)
+        print(String(format: "Allocations \(name): %.1f allocations/call, %.0f bytes/call", budget.allocationsPerCall, budget.bytesPerCall)
+            + (recorded.map { String(format: " (budget %.1f allocations/call, %.0f bytes/call)", $0.allocationsPerCall, $0.bytesPerCall) } ?? " (no budget)"))
+
+        if allocationBudgets.isRecording {
+            allocationBudgets.record(budget, for: name)
+        } else if let recorded = recorded {
+            // Allocations are exact, the slack only covers work that is amortised over the calls. The sizes vary
+            // a little with the lengths of the formatted dates and numbers.
+            XCTAssertLessThanOrEqual(budget.allocationsPerCall, recorded.allocationsPerCall + 0.5,
+                                     "\(name) allocates more than its budget", file: file, line: line)
+            XCTAssertLessThanOrEqual(budget.bytesPerCall, recorded.bytesPerCall * 1.1 + 64,
+                                     "\(name) allocates more bytes than its budget", file: file, line: line)
+        } else {
+            print("StanwoodAnalytics Warning: The allocation budget \(name) is not checked, as it is not recorded. Record it with STANWOOD_BENCHMARK_RECORD=1.")
+        }
+    }
+}
@@ -0,0 +1,271 @@
+import Darwin
+import Foundation
+import XCTest
+
+/// The result of a benchmark.
+struct BenchmarkResult: Codable {
+    /// The median time per event.
+    let nanosecondsPerEvent: Double
+    /// The allocations per event, or nil when allocations cannot be counted.
+    let allocationsPerEvent: Double?
+    /// The events per second at the median time.
+    let eventsPerSecond: Double
+}
+
+/// Keeps the optimiser from removing the work of a benchmark.
+@inline(never)
+func blackHole<T>(_ value: T) {
+}
+
+extension XCTestCase {
+
+    /// Measures a body that handles a number of events, and compares the result with the stored baseline.
+    ///
+    /// The body runs once to warm up, then the given number of times. The time is the median of the runs, and
+    /// the allocations are the fewest of the runs. When the device has no baseline for the benchmark, the result
+    /// is only reported. Set STANWOOD_BENCHMARK_RECORD=1 in the scheme to store the results as the new baseline
+    /// of the device instead of comparing them.
+    ///
+    /// - Parameters:
+    ///   - name: The name of the benchmark, unique in the suite.
+    ///   - events: The number of events the body handles.
+    ///   - runs: The number of measured runs.
+    ///   - body: The work to measure.
+    /// - Returns: The result.
+    @discardableResult
+    func benchmark(_ name: String, events: Int, runs: Int = 5, file: StaticString = #file, line: UInt = #line, _ body: () -> Void) -> BenchmarkResult {
+        AllocationCounter.install()
+        defer { AllocationCounter.uninstall() }
+        body()
+
+        var durations: [UInt64] = []
+        var allocations = Int.max
+        for _ in 0..<runs {
+            let allocationsBefore = AllocationCounter.count
+            let start = DispatchTime.now().uptimeNanoseconds
+            body()
+            let end = DispatchTime.now().uptimeNanoseconds
+            allocations = min(allocations, AllocationCounter.count - allocationsBefore)
+            durations.append(end - start)
+        }
+
+        let median = Double(durations.sorted()[durations.count / 2])
+        let nanosecondsPerEvent = median / Double(events)
+        let result = BenchmarkResult(nanosecondsPerEvent: nanosecondsPerEvent,
+                                     allocationsPerEvent: AllocationCounter.isAvailable ? Double(allocations) / Double(events) : nil,
+                                     eventsPerSecond: 1_000_000_000 / nanosecondsPerEvent)
+
+        let baselines = benchmarkBaselines
+        let baseline = baselines.baseline(for: name)
+        print("Benchmark \(name): \(result.formatted)" + (baseline.map { " (baseline \($0.formatted))" } ?? " (no baseline)"))
+
+        if baselines.isRecording {
+            baselines.record(result, for: name)
+        } else if let baseline = baseline {
+            let maximumTime = baseline.nanosecondsPerEvent * (1 + baselines.tolerance)
+            XCTAssertLessThanOrEqual(result.nanosecondsPerEvent, maximumTime,
+                                     "\(name) is slower than the baseline", file: file, line: line)
+
+            if let current = result.allocationsPerEvent, let stored = baseline.allocationsPerEvent {
+                // Allocations are exact, the slack only covers work that is amortised over the events.
+                XCTAssertLessThanOrEqual(current, stored + 0.5, "\(name) allocates more than the baseline", file: file, line: line)
+            }
+        } else {
+            print("StanwoodAnalytics Warning: The benchmark \(name) is not checked, as it has no baseline for \(baselines.device). Record it with STANWOOD_BENCHMARK_RECORD=1.")
+        }
+
+        return result
+    }
+}
+
+extension BenchmarkResult {
+
+    /// :nodoc:
+    var formatted: String {
+        let allocations = allocationsPerEvent.map { String(format: "%.1f allocations/event", $0) } ?? "allocations not counted"
+        return String(format: "%.0f ns/event, ", nanosecondsPerEvent) + allocations + String(format: ", %.0f events/s", eventsPerSecond)
+    }
+}
+
+// MARK: Baselines
+
+/// The benchmark results, in Baselines/Benchmarks.json. Record them with a Release build, as the Debug build is not optimised.
+let benchmarkBaselines = BaselineStore<BenchmarkResult>(fileName: "Benchmarks.json")
+
+/// Stored results, by device and name, in a file of the Baselines directory next to this file.
+///
+/// Results are only compared on the device they were recorded on, unless they are the same on every device.
+final class BaselineStore<Result: Codable> {
+
+    /// True when STANWOOD_BENCHMARK_RECORD=1 is set.
+    let isRecording: Bool
+
+    /// The fraction by which a benchmark may be slower than its baseline, set with STANWOOD_BENCHMARK_TOLERANCE.
+    /// The default is 0.25.
+    let tolerance: Double
+
+    /// The model of the device, for example iPhone12,1 or iPhone12,1 Simulator, or all when the results are the same on every device.
+    let device: String
+
+    private let url: URL
+    private var results: [String: [String: Result]] = [:]
+
+    /// Init with the name of the file in the Baselines directory.
+    ///
+    /// - Parameters:
+    ///   - fileName: The name of the file.
+    ///   - perDevice: False when the results do not depend on the device, so they are recorded once for all of them.
+    init(fileName: String, perDevice: Bool = true) {
+        url = URL(fileURLWithPath: #file).deletingLastPathComponent().appendingPathComponent("Baselines").appendingPathComponent(fileName)
+
+        let environment = ProcessInfo.processInfo.environment
+        isRecording = environment["STANWOOD_BENCHMARK_RECORD"] == "1"
+        tolerance = environment["STANWOOD_BENCHMARK_TOLERANCE"].flatMap { Double($0) } ?? 0.25
+
+        if !perDevice {
+            device = "all"
+        } else if let simulator = environment["SIMULATOR_MODEL_IDENTIFIER"] {
+            device = simulator + " Simulator"
+        } else {
+            var systemInfo = utsname()
+            uname(&systemInfo)
+            device = withUnsafeBytes(of: &systemInfo.machine) { bytes in
+                String(decoding: bytes.prefix { $0 != 0 }, as: UTF8.self)
+            }
+        }
+
+        if let data = try? Data(contentsOf: url) {
+            do {
+                results = try JSONDecoder().decode([String: [String: Result]].self, from: data)
+            } catch {
+                print("StanwoodAnalytics Warning: The baselines in \(url.lastPathComponent) cannot be read: \(error)")
+            }
+        }
+    }
+
+    /// The baseline of a benchmark on this device.
+    func baseline(for name: String) -> Result? {
+        return results[device]?[name]
+    }
+
+    /// Stores a result as the baseline of a benchmark on this device.
+    func record(_ result: Result, for name: String) {
+        results[device, default: [:]][name] = result
+
+        let encoder = JSONEncoder()
+        encoder.outputFormatting = [.prettyPrinted, .sortedKeys]
+        do {
+            try encoder.encode(results).write(to: url, options: .atomic)
+        } catch {
+            print("StanwoodAnalytics Error: The baselines in \(url.lastPathComponent) cannot be written: \(error)")
+        }
+    }
+}
+
+// MARK: Allocations
+
+/// Counts the heap allocations of every thread, by replacing the allocation functions of the default malloc zone.
+///
+/// The count includes the allocations of the tracker queues, so benchmarks must not run alongside other work.
+/// Install the counter for a measurement only, and uninstall it when the measurement is done.
+enum AllocationCounter {
+
+    /// True while the allocation functions are replaced.
+    private(set) static var isAvailable = false
+
+    /// The allocations counted so far.
+    static var count: Int {
+        return counts.allocations
+    }
+
+    /// The allocations and the bytes requested while the counter was installed. Reallocations count the new size.
+    static var counts: (allocations: Int, bytes: Int) {
+        os_unfair_lock_lock(allocationLock)
+        let counts = (allocationCount, allocatedBytes)
+        os_unfair_lock_unlock(allocationLock)
+        return counts
+    }
+
+    /// Replaces the allocation functions. Has no effect while they are replaced.
+    static func install() {
+        guard !isAvailable, let zone = malloc_default_zone() else { return }
+
+        // The lock is created before the hooks use it, as creating it allocates.
+        _ = allocationLock
+
+        guard protect(zone, PROT_READ | PROT_WRITE) else {
+            print("StanwoodAnalytics Warning: Allocations cannot be counted on this system.")
+            return
+        }
+
+        systemMalloc = zone.pointee.malloc
+        systemCalloc = zone.pointee.calloc
+        systemRealloc = zone.pointee.realloc
+
+        zone.pointee.malloc = { zone, size in
+            countAllocation(of: size)
+            return systemMalloc!(zone, size)
+        }
+        zone.pointee.calloc = { zone, count, size in
+            countAllocation(of: count * size)
+            return systemCalloc!(zone, count, size)
+        }
+        zone.pointee.realloc = { zone, pointer, size in
+            countAllocation(of: size)
+            return systemRealloc!(zone, pointer, size)
+        }
+
+        isAvailable = true
+    }
+
+    /// Restores the allocation functions of the system. Has no effect when they are not replaced.
+    static func uninstall() {
+        guard isAvailable, let zone = malloc_default_zone() else { return }
+
+        // The saved functions are kept, as other threads may still be in a replaced one.
+        zone.pointee.malloc = systemMalloc
+        zone.pointee.calloc = systemCalloc
+        zone.pointee.realloc = systemRealloc
+        _ = protect(zone, PROT_READ)
+
+        isAvailable = false
+    }
+
+    /// Sets the protection of the pages of a zone. The zone is read only after the first allocation.
+    private static func protect(_ zone: UnsafeMutablePointer<malloc_zone_t>, _ protection: Int32) -> Bool {
+        let pageSize = Int(getpagesize())
+        let start = Int(bitPattern: zone) & ~(pageSize - 1)
+        let end = Int(bitPattern: zone) + MemoryLayout<malloc_zone_t>.size
+        return mprotect(UnsafeMutableRawPointer(bitPattern: start), end - start, protection) == 0
+    }
+}
+
+/// :nodoc:
+private let allocationLock: UnsafeMutablePointer<os_unfair_lock> = {
+    let lock = UnsafeMutablePointer<os_unfair_lock>.allocate(capacity: 1)
+    lock.initialize(to: os_unfair_lock())
+    return lock
+}()
+
+/// :nodoc:
+private var allocationCount = 0
+
+/// :nodoc:
+private var allocatedBytes = 0
+
+/// :nodoc:
+private var systemMalloc: (@convention(c) (UnsafeMutablePointer<malloc_zone_t>?, Int) -> UnsafeMutableRawPointer?)?
+
+/// :nodoc:
+private var systemCalloc: (@convention(c) (UnsafeMutablePointer<malloc_zone_t>?, Int, Int) -> UnsafeMutableRawPointer?)?
+
+/// :nodoc:
+private var systemRealloc: (@convention(c) (UnsafeMutablePointer<malloc_zone_t>?, UnsafeMutableRawPointer?, Int) -> UnsafeMutableRawPointer?)?
+
+/// :nodoc:
+private func countAllocation(of size: Int) {
+    os_unfair_lock_lock(allocationLock)
+    allocationCount += 1
+    allocatedBytes += size
+    os_unfair_lock_unlock(allocationLock)
+}
@@ -0,0 +1,167 @@
+import XCTest
+import Firebase
+import StanwoodAnalytics
+
+/// Benchmarks of the dispatch and payload paths of the core, with stub trackers.
+///
+/// Run them with the Release configuration; see Benchmark.swift for recording the baselines.
+class CoreBenchmarks: XCTestCase {
+
+    /// The numbers of custom values of the tracked parameters.
+    private let customValueCounts = [0, 4, 16]
+
+    /// The events of each run.
+    private let events = 2_000
+
+    // MARK: Dispatch
+
+    func testTrackFanOut() {
+        for trackerCount in [1, 2, 4, 8, 16] {
+            for customValueCount in customValueCounts {
+                let (analytics, stubs) = StanwoodAnalytics.stubbed(trackers: trackerCount, capacity: events)
+                let parameters = TrackingParameters.benchmark(customValues: customValueCount)
+                let runs = 5
+
+                benchmark("track.\(trackerCount)trackers.\(customValueCount)values", events: events, runs: runs) {
+                    for _ in 0..<events {
+                        analytics.track(trackingParameters: parameters)
+                    }
+                    analytics.flush()
+                }
+
+                // The warm up run and the measured runs, with no event dropped.
+                for stub in stubs {
+                    XCTAssertEqual(stub.eventCount, events * (runs + 1))
+                }
+            }
+        }
+    }
+
+    func testTrackScreen() {
+        let (analytics, stubs) = StanwoodAnalytics.stubbed(trackers: 4, capacity: events)
+        let runs = 5
+
+        benchmark("trackScreen.4trackers", events: events, runs: runs) {
+            for _ in 0..<events {
+                analytics.trackScreen(name: "ProductDetail", className: "ProductViewController")
+            }
+            analytics.flush()
+        }
+
+        for stub in stubs {
+            XCTAssertEqual(stub.keysCount, events * (runs + 1))
+        }
+    }
+
+    // MARK: Payloads
+
+    func testTrackingParametersPayload() {
+        for customValueCount in customValueCounts {
+            let parameters = TrackingParameters.benchmark(customValues: customValueCount)
+
+            benchmark("payload.\(customValueCount)values", events: events) {
+                for _ in 0..<events {
+                    blackHole(parameters.payload())
+                }
+            }
+        }
+    }
+
+    func testTrackingParametersDebugInfo() {
+        for customValueCount in customValueCounts {
+            let parameters = TrackingParameters.benchmark(customValues: customValueCount)
+
+            benchmark("debugInfo.\(customValueCount)values", events: events) {
+                for _ in 0..<events {
+                    blackHole(parameters.debugInfo())
+                }
+            }
+        }
+    }
+
+    func testTrackerKeysPayload() {
+        for customValueCount in customValueCounts {
+            var trackerKeys = TrackerKeys()
+            trackerKeys.set("ProductDetail", forKey: StanwoodAnalytics.Keys.screenName)
+            for index in 0..<customValueCount {
+                trackerKeys.set(index, forKey: "key_\(index)")
+            }
+
+            benchmark("trackerKeysPayload.\(customValueCount)values", events: events) {
+                for _ in 0..<events {
+                    blackHole(trackerKeys.payload())
+                }
+            }
+        }
+    }
+
+    // MARK: Mappers
+
+    /// The plan of the default Firebase mapper.
+    private let firebasePlan = MappingPlan()
+        .map(.itemId, to: AnalyticsParameterItemID)
+        .map(.contentType, to: AnalyticsParameterContentType)
+        .map(.category, to: AnalyticsParameterItemCategory)
+        .map(.name, to: AnalyticsParameterItemName)
+
+    /// A plan that also maps custom values, with transforms.
+    private func customPlan(customValues count: Int) -> MappingPlan {
+        var plan = firebasePlan.map(.eventName, to: "event", transform: .lowercased)
+        for index in 0..<count {
+            plan = plan.map(.custom("custom_\(index)"), to: "mapped_\(index)", transform: .truncated(40))
+        }
+        return plan
+    }
+
+    func testFirebaseMapping() {
+        let mapper = firebasePlan.compile()
+
+        for customValueCount in customValueCounts {
+            let parameters = TrackingParameters.benchmark(customValues: customValueCount)
+
+            benchmark("firebaseMapping.\(customValueCount)values", events: events) {
+                for _ in 0..<events {
+                    blackHole(mapper.map(parameters: parameters))
+                }
+            }
+        }
+    }
+
+    func testMappingPlan() {
+        for customValueCount in customValueCounts {
+            let parameters = TrackingParameters.benchmark(customValues: customValueCount)
+            let plan = customPlan(customValues: customValueCount)
+            let compiled = plan.compile()
+
+            benchmark("mappingPlan.\(customValueCount)values", events: events) {
+                for _ in 0..<events {
+                    blackHole(plan.map(parameters: parameters))
+                }
+            }
+
+            benchmark("compiledMappingPlan.\(customValueCount)values", events: events) {
+                for _ in 0..<events {
+                    blackHole(compiled.map(parameters: parameters))
+                }
+            }
+        }
+    }
+
+    func testPreparedEventMapping() {
+        let mapper = firebasePlan.compile()
+
+        for customValueCount in customValueCounts {
+            let parameters = TrackingParameters.benchmark(customValues: customValueCount)
+
+            // A new prepared event per event, mapped as often as there are trackers that share it.
+            benchmark("preparedEvent.4mappings.\(customValueCount)values", events: events) {
+                for _ in 0..<events {
+                    let event = PreparedEvent(parameters)
+                    for _ in 0..<4 {
+                        blackHole(event.mapped(by: mapper))
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,148 @@
+import XCTest
+import StanwoodAnalytics
+
+/// Soak and stress tests of the tracking pipeline, calling StanwoodAnalytics from many threads at once.
+///
+/// Run them with the StanwoodAnalytics-Stress scheme, which enables the Thread Sanitizer. Set
+/// STANWOOD_STRESS_OPERATIONS to change the number of operations of a run; the default is one million.
+class StressTests: XCTestCase {
+
+    private let operations = ProcessInfo.processInfo.environment["STANWOOD_STRESS_OPERATIONS"].flatMap { Int($0) } ?? 1_000_000
+    private let threads = 16
+    private let trackerCount = 4
+
+    /// The growth of the memory footprint allowed over a run.
+    private let memoryBound = 64 * 1024 * 1024
+
+    private let error = NSError(domain: "io.stanwood.stress", code: 42, userInfo: nil)
+
+    override func tearDown() {
+        DataStore.setTracking(enabled: true)
+        super.tearDown()
+    }
+
+    /// Mixed operations from every thread: 10 in 16 are events, 3 are keys, 2 are errors and 1 is setTracking.
+    func testConcurrentMixedOperations() {
+        let (analytics, stubs) = StanwoodAnalytics.stubbed(trackers: trackerCount, capacity: 4096, checksSequence: true)
+        let operationsPerThread = operations / threads
+        let footprintBefore = memoryFootprint()
+
+        DispatchQueue.concurrentPerform(iterations: threads) { thread in
+            var keys = TrackerKeys()
+            keys.set("user-\(thread)", forKey: StanwoodAnalytics.Keys.identifier)
+
+            for index in 0..<operationsPerThread {
+                switch index % 16 {
+                case 0..<10:
+                    var parameters = TrackingParameters(eventName: "stress", name: "thread \(thread)")
+                    parameters.customValues[StubTracker.sequenceKey] = .int(thread * operationsPerThread + index)
+                    analytics.track(trackingParameters: parameters)
+                case 10..<13:
+                    analytics.track(trackerKeys: keys)
+                case 13..<15:
+                    analytics.track(error: error)
+                default:
+                    // Tracking is on, so this only tracks the opt-in event.
+                    analytics.setTracking(enabled: true)
+                }
+            }
+        }
+        analytics.flush()
+
+        let events = threads * operationCount(in: 0..<10, of: operationsPerThread)
+        let optIns = threads * operationCount(in: 15..<16, of: operationsPerThread)
+        var sequenceNumbers = IndexSet()
+        for thread in 0..<threads {
+            for index in 0..<operationsPerThread where index % 16 < 10 {
+                sequenceNumbers.insert(thread * operationsPerThread + index)
+            }
+        }
+
+        for stub in stubs {
+            XCTAssertEqual(stub.eventCount, events + optIns)
+            XCTAssertEqual(stub.keysCount, threads * operationCount(in: 10..<13, of: operationsPerThread))
+            XCTAssertEqual(stub.errorCount, threads * operationCount(in: 13..<15, of: operationsPerThread))
+            XCTAssertEqual(stub.duplicateCount, 0)
+            XCTAssertEqual(stub.sequenceNumbers, sequenceNumbers, "Events were lost")
+        }
+
+        for statistics in analytics.bufferStatistics() {
+            XCTAssertEqual(statistics.dropped, 0)
+        }
+
+        // Every delivered operation is timed once.
+        let latencies = analytics.latencyStatistics()
+        XCTAssertEqual(latencies.filter { $0.call == .trackParameters }.reduce(0) { $0 + $1.count }, stubs.reduce(0) { $0 + $1.eventCount })
+        XCTAssertEqual(latencies.filter { $0.call == .trackError }.reduce(0) { $0 + $1.count }, stubs.reduce(0) { $0 + $1.errorCount })
+
+        XCTAssertLessThan(memoryFootprint() - footprintBefore, memoryBound)
+    }
+
+    /// Tracking turned on from many threads while they track: the trackers are started once, before any event.
+    func testConcurrentEnable() {
+        let (analytics, stubs) = StanwoodAnalytics.stubbed(trackers: trackerCount, capacity: 4096, checksSequence: true, trackingEnabled: false)
+        let operationsPerThread = min(operations / threads, 10_000)
+
+        DispatchQueue.concurrentPerform(iterations: threads) { thread in
+            for index in 0..<operationsPerThread {
+                if index == operationsPerThread / 2 {
+                    analytics.setTracking(enabled: true)
+                }
+
+                var parameters = TrackingParameters(eventName: "stress", name: "thread \(thread)")
+                parameters.customValues[StubTracker.sequenceKey] = .int(thread * operationsPerThread + index)
+                analytics.track(trackingParameters: parameters)
+            }
+        }
+        analytics.flush()
+
+        for stub in stubs {
+            XCTAssertEqual(stub.startCount, 1)
+            XCTAssertEqual(stub.eventsBeforeStart, 0)
+            XCTAssertEqual(stub.duplicateCount, 0)
+            // Every thread tracks at least the second half of its events after turning tracking on.
+            XCTAssertGreaterThanOrEqual(stub.sequenceNumbers.count, threads * (operationsPerThread - operationsPerThread / 2))
+        }
+    }
+
+    /// Builds and releases instances while other threads track on them, to find races in the set up and tear down.
+    func testConcurrentInstances() {
+        let instances = min(operations / 10_000, 200)
+
+        for _ in 0..<instances {
+            let (analytics, stubs) = StanwoodAnalytics.stubbed(trackers: trackerCount, capacity: 256)
+
+            DispatchQueue.concurrentPerform(iterations: threads) { thread in
+                analytics.track(trackingParameters: TrackingParameters(eventName: "stress", name: "thread \(thread)"))
+                analytics.trackScreen(name: "Screen \(thread)")
+            }
+            analytics.flush()
+
+            for stub in stubs {
+                XCTAssertEqual(stub.eventCount, threads)
+                XCTAssertEqual(stub.keysCount, threads)
+            }
+        }
+    }
+
+    // MARK: Helpers
+
+    /// The operations of a thread whose index modulo 16 is in the range.
+    private func operationCount(in range: Range<Int>, of operationsPerThread: Int) -> Int {
+        let cycles = operationsPerThread / 16
+        let remainder = operationsPerThread % 16
+        return cycles * range.count + range.clamped(to: 0..<remainder).count
+    }
+
+    /// The memory footprint of the process, in bytes.
+    private func memoryFootprint() -> Int {
+        var info = task_vm_info_data_t()
+        var count = mach_msg_type_number_t(MemoryLayout<task_vm_info_data_t>.size / MemoryLayout<natural_t>.size)
+        let result = withUnsafeMutablePointer(to: &info) { pointer in
+            pointer.withMemoryRebound(to: integer_t.self, capacity: Int(count)) {
+                task_info(mach_task_self_, task_flavor_t(TASK_VM_INFO), $0, &count)
+            }
+        }
+        return result == KERN_SUCCESS ? Int(info.phys_footprint) : 0
+    }
+}
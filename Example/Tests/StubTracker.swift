@@ -0,0 +1,166 @@
+import UIKit
+import StanwoodAnalytics
+
+/// A tracker that only counts the operations it receives, to measure the overhead of StanwoodAnalytics itself.
+///
+/// Each tracker is called on the serial queue of its channel, or the main thread for its main thread calls, one call at
+/// a time, so the counts are read after StanwoodAnalytics.flush().
+final class StubTracker: Tracker {
+
+    /// The custom value holding the sequence number of an event, checked when checksSequence is set.
+    static let sequenceKey = "sequence"
+
+    private(set) var startCount = 0
+    private(set) var eventCount = 0
+    private(set) var keysCount = 0
+    private(set) var errorCount = 0
+    private(set) var consentCount = 0
+
+    /// The events received before start() was called.
+    private(set) var eventsBeforeStart = 0
+
+    /// The sequence numbers received, and the ones received more than once.
+    private(set) var sequenceNumbers = IndexSet()
+    private(set) var duplicateCount = 0
+
+    /// The calls in the order they were made, when the builder logs them.
+    private(set) var calls: [TrackerCall] = []
+    /// The calls required on the main thread that were made on another thread.
+    private(set) var offMainThreadCount = 0
+
+    private let checksSequence: Bool
+    private let logsCalls: Bool
+    private let eventDelay: TimeInterval
+    private let requiredMainThreadCalls: Set<TrackerCall>
+
+    init(builder: StubBuilder) {
+        checksSequence = builder.checksSequence
+        logsCalls = builder.logsCalls
+        eventDelay = builder.eventDelay
+        requiredMainThreadCalls = builder.mainThreadCalls
+        super.init(builder: builder)
+    }
+
+    override var mainThreadCalls: Set<TrackerCall> {
+        return requiredMainThreadCalls
+    }
+
+    /// :nodoc:
+    private func called(_ call: TrackerCall) {
+        if logsCalls {
+            calls.append(call)
+        }
+        if requiredMainThreadCalls.contains(call) && !Thread.isMainThread {
+            offMainThreadCount += 1
+        }
+    }
+
+    override func start() {
+        called(.start)
+        startCount += 1
+    }
+
+    override func track(trackingParameters: TrackingParameters) {
+        track(event: PreparedEvent(trackingParameters))
+    }
+
+    override func track(event: PreparedEvent) {
+        called(.trackParameters)
+        eventCount += 1
+
+        if eventDelay > 0 {
+            Thread.sleep(forTimeInterval: eventDelay)
+        }
+
+        if startCount == 0 {
+            eventsBeforeStart += 1
+        }
+
+        if checksSequence, case .int(let number)? = event.parameters.customValues[StubTracker.sequenceKey] {
+            if !sequenceNumbers.insert(number).inserted {
+                duplicateCount += 1
+            }
+        }
+    }
+
+    override func track(trackerKeys: TrackerKeys) {
+        called(.trackKeys)
+        keysCount += 1
+    }
+
+    override func track(error: NSError) {
+        called(.trackError)
+        errorCount += 1
+    }
+
+    override func setTracking(enabled: Bool) {
+        called(.setTracking)
+        consentCount += 1
+    }
+
+    /// The builder for the stub tracker.
+    final class StubBuilder: Tracker.Builder {
+        let checksSequence: Bool
+        let logsCalls: Bool
+        let mainThreadCalls: Set<TrackerCall>
+        let eventDelay: TimeInterval
+
+        /// Init with a buffer that holds the given number of events and blocks when it is full, so no event is dropped.
+        ///
+        /// - Parameters:
+        ///   - capacity: The buffer capacity.
+        ///   - checksSequence: Record the sequence numbers of the events, to find the lost and duplicated ones.
+        ///   - logsCalls: Record the calls in the order they were made.
+        ///   - mainThreadCalls: The calls the tracker requires on the main thread.
+        ///   - eventDelay: The time each event takes to track, in seconds.
+        init(capacity: Int, checksSequence: Bool = false, logsCalls: Bool = false, mainThreadCalls: Set<TrackerCall> = [], eventDelay: TimeInterval = 0) {
+            self.checksSequence = checksSequence
+            self.logsCalls = logsCalls
+            self.mainThreadCalls = mainThreadCalls
+            self.eventDelay = eventDelay
+            super.init(context: UIApplication.shared)
+            _ = setBuffer(capacity: capacity, overflowPolicy: .block(timeout: 60))
+        }
+
+        override func build() -> StubTracker {
+            return StubTracker(builder: self)
+        }
+    }
+}
+
+extension StanwoodAnalytics {
+
+    /// Builds an instance with stub trackers.
+    ///
+    /// - Parameters:
+    ///   - trackers: The number of stub trackers.
+    ///   - capacity: The buffer capacity of each tracker.
+    ///   - checksSequence: Record the sequence numbers of the events.
+    ///   - trackingEnabled: The stored tracking switch the instance starts with.
+    /// - Returns: The instance and its trackers.
+    static func stubbed(trackers: Int, capacity: Int = 1024, checksSequence: Bool = false, trackingEnabled: Bool = true) -> (StanwoodAnalytics, [StubTracker]) {
+        DataStore.setTracking(enabled: trackingEnabled)
+
+        let stubs = (0..<trackers).map { _ in StubTracker.StubBuilder(capacity: capacity, checksSequence: checksSequence).build() }
+        let builder = StanwoodAnalytics.builder()
+        stubs.forEach { _ = builder.add(tracker: $0) }
+        return (builder.build(), stubs)
+    }
+}
+
+extension TrackingParameters {
+
+    /// Parameters with every field set and the given number of custom values, alternating strings and numbers.
+    static func benchmark(eventName: String = StanwoodAnalytics.TrackingEvent.viewItem.rawValue, customValues count: Int) -> TrackingParameters {
+        var parameters = TrackingParameters(eventName: eventName,
+                                            itemId: "item-4711",
+                                            name: "A product with a longer name",
+                                            description: "The description of the product",
+                                            category: "products",
+                                            contentType: "article")
+        for index in 0..<count {
+            parameters.customValues["custom_\(index)"] = index % 2 == 0 ? .string("value \(index)") : .int(index)
+        }
+        return parameters
+    }
+}
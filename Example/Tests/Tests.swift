@@ -4,18 +4,150 @@ import StanwoodAnalytics
 
 class Tests: XCTestCase {
 
-    override func setUp() {
-        super.setUp()
-        // Put setup code here. This method is called before the invocation of each test method in the class.
+    /// The calls a tracker requires on the main thread are made there, in order with the calls made on its queue,
+    /// and flush() waits for them from any thread.
+    func testMainThreadCalls() {
+        DataStore.setTracking(enabled: true)
+        let tracker = StubTracker.StubBuilder(capacity: 64, logsCalls: true, mainThreadCalls: [.trackKeys]).build()
+        let analytics = StanwoodAnalytics.builder().add(tracker: tracker).build()
+
+        var keys = TrackerKeys()
+        keys.set("user", forKey: StanwoodAnalytics.Keys.identifier)
+
+        let flushed = expectation(description: "flushed")
+        DispatchQueue.global().async {
+            for _ in 0..<10 {
+                analytics.track(trackingParameters: TrackingParameters(eventName: "main_thread"))
+                analytics.track(trackerKeys: keys)
+            }
+            analytics.flush()
+            flushed.fulfill()
+        }
+        wait(for: [flushed], timeout: 10)
+
+        analytics.track(trackerKeys: keys)
+        analytics.track(trackingParameters: TrackingParameters(eventName: "main_thread"))
+        analytics.flush()
+
+        let expected = Array(repeating: [TrackerCall.trackParameters, .trackKeys], count: 10).flatMap { $0 } + [.trackKeys, .trackParameters]
+        XCTAssertEqual(tracker.calls.filter { $0 != .start }, expected)
+        XCTAssertEqual(tracker.offMainThreadCount, 0)
+    }
+
+    /// A full buffer drops the oldest event, never a start or setTracking waiting in the buffer.
+    func testOverflowKeepsControlOperations() {
+        DataStore.setTracking(enabled: false)
+        let builder = StubTracker.StubBuilder(capacity: 2)
+        // The long batch latency holds the operations in the buffer until the flush.
+        _ = builder.setBuffer(capacity: 2, overflowPolicy: .dropOldest).setBatching(size: 100, latency: 60_000)
+        let tracker = builder.build()
+        let analytics = StanwoodAnalytics.builder().add(tracker: tracker).build()
+
+        // Enqueues start and the opt-in event.
+        analytics.setTracking(enabled: true)
+        for _ in 0..<3 {
+            analytics.track(trackingParameters: TrackingParameters(eventName: "overflow"))
+        }
+        analytics.flush()
+
+        XCTAssertEqual(tracker.startCount, 1)
+        XCTAssertEqual(tracker.eventCount, 1)
+        XCTAssertEqual(analytics.bufferStatistics().first?.dropped, 3)
     }
 
-    override func tearDown() {
-        // Put teardown code here. This method is called after the invocation of each test method in the class.
-        super.tearDown()
+    /// A batch is held to the budget for each of its events, so cheap events in a large batch do not open the breaker.
+    func testBatchingWithBudget() {
+        DataStore.setTracking(enabled: true)
+        let builder = StubTracker.StubBuilder(capacity: 256, eventDelay: 0.005)
+        _ = builder.setBatching(size: 10, latency: 1000).setBudget(latency: 20, failures: 2)
+        let tracker = builder.build()
+        let analytics = StanwoodAnalytics.builder().add(tracker: tracker).build()
+
+        for _ in 0..<100 {
+            analytics.track(trackingParameters: TrackingParameters(eventName: "batched"))
+        }
+        analytics.flush()
+
+        XCTAssertEqual(tracker.eventCount, 100)
+        XCTAssertEqual(analytics.bufferStatistics().first?.shed, 0)
+    }
+
+    /// Mappers of the same type configured differently each get their own mapping of a prepared event.
+    func testMappedByInstance() {
+        final class PrefixMapper: ParameterMapper {
+            let prefix: String
+
+            init(prefix: String) {
+                self.prefix = prefix
+            }
+
+            func map(parameters: TrackingParameters) -> [String: NSString] {
+                return ["name": (prefix + parameters.eventName) as NSString]
+            }
+        }
+
+        let event = PreparedEvent(TrackingParameters(eventName: "event"))
+        let first = PrefixMapper(prefix: "first_")
+        let second = PrefixMapper(prefix: "second_")
+
+        XCTAssertEqual(event.mapped(by: first)["name"], "first_event")
+        XCTAssertEqual(event.mapped(by: second)["name"], "second_event")
+        XCTAssertEqual(event.mapped(by: first)["name"], "first_event")
+    }
+
+    /// Custom values of unsupported types are kept, and single values are set without converting the others.
+    func testUntypedCustomValues() {
+        let url = URL(string: "https://stanwood.io")!
+        var parameters = TrackingParameters(eventName: "untyped")
+        parameters.customParameters = ["tags": ["a", "b"], "count": 3]
+        parameters[customParameter: "url"] = url
+
+        XCTAssertEqual(parameters.customValues["count"], .int(3))
+        XCTAssertEqual(parameters[customParameter: "tags"] as? [String], ["a", "b"])
+        XCTAssertEqual(parameters.customParameters["url"] as? URL, url)
+
+        var keys = TrackerKeys()
+        keys[customKey: "ids"] = [1, 2]
+        XCTAssertEqual(keys.customKeys["ids"] as? [Int], [1, 2])
+    }
+
+    /// Custom values of any type are mapped as strings, and a plan is compiled once.
+    func testMappingPlanCustomValues() {
+        let plan = MappingPlan()
+            .map(.custom("price"), to: "price")
+            .map(.custom("quantity"), to: "quantity")
+        var parameters = TrackingParameters(eventName: "purchase")
+        parameters.customValues["price"] = 9.5
+        parameters.customValues["quantity"] = 2
+
+        let mapped = plan.map(parameters: parameters)
+        XCTAssertEqual(mapped["price"], "9.5")
+        XCTAssertEqual(mapped["quantity"], "2")
+        XCTAssertTrue(plan.compile() === plan.compile())
+    }
+
+    /// Event names that find no bucket of their own share the overflow bucket instead of going unlimited.
+    func testRateLimitOverflow() {
+        DataStore.setTracking(enabled: true)
+        let tracker = StubTracker.StubBuilder(capacity: 4096).build()
+        let analytics = StanwoodAnalytics.builder()
+            .add(tracker: tracker)
+            .setRateLimit(eventsPerSecond: 0.001, burst: 1)
+            .build()
+
+        for index in 0..<2000 {
+            analytics.track(trackingParameters: TrackingParameters(eventName: "dynamic_\(index)"))
+        }
+        analytics.flush()
+
+        // At most one event for each of the 256 buckets, one for the overflow bucket and its summary.
+        XCTAssertLessThanOrEqual(tracker.eventCount, 258)
     }
 
-    func testExample() {
-        // This is an example of a functional test case.
-        XCTAssert(true, "Pass")
+    /// Every event has a symbol, and its name is matched ignoring case.
+    func testIsEvent() {
+        for event in StanwoodAnalytics.TrackingEvent.allCases {
+            XCTAssertTrue(TrackingParameters(eventName: event.rawValue.uppercased()).isEvent(event), event.rawValue)
+        }
     }
 }
@@ -0,0 +1,135 @@
+import Foundation
+import Mixpanel
+import StanwoodAnalytics
+
+/// A stand-in for a vendor SDK that counts the calls made to it.
+///
+/// The adapters are called directly in the benchmarks, on one thread, so the count is not locked.
+class VendorStandIn {
+    private(set) var calls = 0
+
+    /// :nodoc:
+    func count() {
+        calls += 1
+    }
+}
+
+final class FirebaseAnalyticsStandIn: VendorStandIn, FirebaseAnalyticsEnabler {
+
+    func logEvent(_ name: String, parameters: [String: Any]?) {
+        count()
+        blackHole(parameters)
+    }
+
+    func setScreenName(_ screenName: String, screenClass: String?) {
+        count()
+    }
+
+    func setAnalyticsCollectionEnabled(_ enabled: Bool) {
+        count()
+    }
+}
+
+final class MixpanelStandIn: VendorStandIn, MixpanelEnabler {
+
+    func initialize(token: String, loggingEnabled: Bool) {
+        count()
+    }
+
+    func track(event: String, properties: Properties) {
+        count()
+        blackHole(properties)
+    }
+
+    func identify(distinctId: String) {
+        count()
+    }
+
+    func setPeople(property: String, to value: MixpanelType) {
+        count()
+    }
+
+    func setTracking(enabled: Bool) {
+        count()
+    }
+}
+
+final class CrashlyticsStandIn: VendorStandIn, CrashlyticsEnabler {
+
+    func configure() {
+        count()
+    }
+
+    func log(_ message: String) {
+        count()
+    }
+
+    func record(error: NSError) {
+        count()
+    }
+
+    func setUserID(_ identifier: String) {
+        count()
+    }
+
+    func setCustomValue(_ value: Any, forKey key: String) {
+        count()
+    }
+}
+
+final class TestFairyStandIn: VendorStandIn, TestFairyEnabler {
+
+    func begin(_ appToken: String?) {
+        count()
+    }
+
+    func log(_ message: String) {
+        count()
+    }
+
+    func setUserId(_ userId: String) {
+        count()
+    }
+}
+
+final class GoogleAnalyticsStandIn: VendorStandIn, GoogleAnalyticsEnabler {
+    let tracker = GAITrackerStandIn()
+
+    func start(trackUncaughtExceptions: Bool, verboseLogging: Bool) {
+        count()
+    }
+
+    func tracker(withTrackingId trackingId: String?) -> GAITracker? {
+        count()
+        return tracker
+    }
+
+    func setOptOut(_ optOut: Bool) {
+        count()
+    }
+}
+
+/// A GAITracker that counts the fields it is given and the hits it sends.
+final class GAITrackerStandIn: NSObject, GAITracker {
+    private(set) var fields = 0
+    private(set) var hits = 0
+
+    var name: String! {
+        return "stand-in"
+    }
+
+    var allowIDFACollection = false
+
+    func set(_ parameterName: String!, value: String!) {
+        fields += 1
+    }
+
+    func get(_ parameterName: String!) -> String! {
+        return nil
+    }
+
+    func send(_ parameters: [AnyHashable: Any]!) {
+        hits += 1
+        blackHole(parameters)
+    }
+}
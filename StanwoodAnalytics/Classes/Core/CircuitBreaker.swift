@@ -0,0 +1,118 @@
+//
+//  CircuitBreaker.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// The overhead allowed for each call on a tracker, set with setBudget(latency:cpuTime:failures:cooldown:) in the builder.
+struct OverheadBudget {
+    /// The maximum duration of a call in nanoseconds.
+    let latency: UInt64
+    /// The maximum CPU time of a call in nanoseconds, or nil for no limit.
+    let cpuTime: UInt64?
+    /// The number of consecutive calls over the budget that open the breaker.
+    let failures: Int
+    /// The time in nanoseconds the breaker stays open before a probe.
+    let cooldown: UInt64
+}
+
+/// Stops the calls on a tracker that keeps going over its overhead budget.
+///
+/// The breaker starts closed, and every call is made. After a number of consecutive calls over the budget it opens,
+/// and the operations for the tracker are shed. Once the cooldown has passed it is half open: the next operation is a
+/// probe, which closes the breaker if it is within the budget and opens it again if not.
+///
+/// The breaker is only used by the thread delivering to the tracker, one call at a time, so it is not locked.
+final class CircuitBreaker {
+
+    /// The state of a breaker.
+    enum State: String {
+        case closed
+        case open
+        case halfOpen = "half_open"
+    }
+
+    private let budget: OverheadBudget
+    private(set) var state: State = .closed
+    private var failures = 0
+    private var openedAt: UInt64 = 0
+
+    /// True when the budget limits the CPU time, which then has to be measured.
+    var measuresCPUTime: Bool {
+        return budget.cpuTime != nil
+    }
+
+    /// Init with the budget.
+    init(budget: OverheadBudget) {
+        self.budget = budget
+    }
+
+    /// Whether the next call can be made. An open breaker becomes half open once the cooldown has passed.
+    ///
+    /// - Parameter now: The uptime in nanoseconds.
+    func allowsCall(now: UInt64 = DispatchTime.now().uptimeNanoseconds) -> Bool {
+        if state == .open && now &- openedAt >= budget.cooldown {
+            state = .halfOpen
+        }
+        return state != .open
+    }
+
+    /// Records the cost of a call.
+    ///
+    /// - Parameters:
+    ///   - duration: The duration of the call in nanoseconds.
+    ///   - cpuTime: The CPU time of the call in nanoseconds, if it was measured.
+    ///   - now: The uptime in nanoseconds.
+    func record(duration: UInt64, cpuTime: UInt64?, now: UInt64 = DispatchTime.now().uptimeNanoseconds) {
+        var isOverBudget = duration > budget.latency
+        if let limit = budget.cpuTime, let cpuTime = cpuTime, cpuTime > limit {
+            isOverBudget = true
+        }
+
+        switch state {
+        case .closed:
+            failures = isOverBudget ? failures + 1 : 0
+            if failures >= budget.failures {
+                open(now: now)
+            }
+        case .halfOpen:
+            if isOverBudget {
+                open(now: now)
+            } else {
+                state = .closed
+                failures = 0
+            }
+        case .open:
+            // No calls are made while the breaker is open.
+            break
+        }
+    }
+
+    /// :nodoc:
+    private func open(now: UInt64) {
+        state = .open
+        openedAt = now
+        failures = 0
+    }
+}
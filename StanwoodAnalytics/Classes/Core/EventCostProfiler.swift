@@ -0,0 +1,269 @@
+//
+//  EventCostProfiler.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// The cost of an event name, summed over all the trackers.
+///
+/// The values are estimates from a count-min sketch. They are never lower than the true values, and are higher by
+/// at most a small share of the totals of all the events when event names collide in the sketch.
+public struct EventCost {
+    /// The event name.
+    public let eventName: String
+    /// The number of events tracked with the name.
+    public let events: Int
+    /// The number of calls on the trackers that delivered the events. A batch counts as one call for each event.
+    public let trackerCalls: Int
+    /// The CPU time of the tracker calls in seconds, including the mapping and the vendor frameworks.
+    public let cpuTime: TimeInterval
+    /// The growth of the heap during the tracker calls, in bytes.
+    public let allocatedBytes: Int
+}
+
+/// The CPU time of the current thread and the bytes in use in the heap, read before and after a tracker call.
+struct ResourceUsage {
+    let cpuNanoseconds: UInt64
+    /// The bytes in use, or nil when the heap was not read.
+    let bytesInUse: Int?
+
+    /// The usage now.
+    ///
+    /// - Parameter readingHeap: True to read the bytes in use, which walks every malloc zone.
+    static func current(readingHeap: Bool) -> ResourceUsage {
+        var bytesInUse: Int?
+        if readingHeap {
+            var statistics = malloc_statistics_t()
+            malloc_zone_statistics(nil, &statistics)
+            bytesInUse = statistics.size_in_use
+        }
+        return ResourceUsage(cpuNanoseconds: clock_gettime_nsec_np(CLOCK_THREAD_CPUTIME_ID), bytesInUse: bytesInUse)
+    }
+}
+
+/// Attributes the cost of the tracker calls to event names, in fixed memory.
+///
+/// The costs are added to a count-min sketch: 4 rows of 512 counters, with each event name hashed to one counter in
+/// each row. The estimate of a name is the minimum of its counters, so a collision can only raise it. The names with
+/// the most CPU time are kept in a min-heap of fixed size, so the report lists them without storing every name.
+///
+/// The heap growth is read from the malloc statistics of the process. Reading them walks every malloc zone, so they are
+/// only read around one tracker call in `heapSampleInterval`, and the growth of that call stands for the calls in
+/// between. It also includes the allocations of other threads running at the same time, and is only a guide.
+final class EventCostProfiler {
+
+    /// The tracker calls of a channel for each call around which the heap is read.
+    static let heapSampleInterval = 16
+
+    /// The counters of a cell of the sketch.
+    private struct Counters {
+        var events: UInt64 = 0
+        var trackerCalls: UInt64 = 0
+        var cpuNanoseconds: UInt64 = 0
+        var bytes: UInt64 = 0
+    }
+
+    /// An event name in the heap, with the estimate of its CPU time when it was last updated.
+    private struct HeavyHitter {
+        let eventName: String
+        var cpuNanoseconds: UInt64
+    }
+
+    /// :nodoc:
+    private static let width = 512
+    /// :nodoc:
+    private static let depth = 4
+
+    private let capacity: Int
+    private var sketch: [Counters]
+    private var heap: [HeavyHitter] = []
+    private var heapIndices: [String: Int] = [:]
+    private let lock = NSLock()
+
+    /// Init with the number of event names to keep.
+    ///
+    /// - Parameter topEvents: The size of the heap of the costliest event names.
+    init(topEvents: Int) {
+        capacity = max(1, topEvents)
+        sketch = Array(repeating: Counters(), count: EventCostProfiler.width * EventCostProfiler.depth)
+        heap.reserveCapacity(capacity)
+        heapIndices.reserveCapacity(capacity)
+    }
+
+    /// Counts an event tracked with the name.
+    func recordEvent(_ eventName: String) {
+        var counters = Counters()
+        counters.events = 1
+
+        lock.lock()
+        add(counters, to: eventName)
+        lock.unlock()
+    }
+
+    /// Attributes the cost of a tracker call to the events it delivered, split evenly between them.
+    ///
+    /// - Parameters:
+    ///   - eventNames: The names of the events delivered by the call.
+    ///   - usage: The usage read before the call. The heap growth is only counted when the heap was read.
+    func recordCall<Names: Collection>(_ eventNames: Names, since usage: ResourceUsage) where Names.Element == String {
+        guard !eventNames.isEmpty else { return }
+
+        let now = ResourceUsage.current(readingHeap: usage.bytesInUse != nil)
+        let count = UInt64(eventNames.count)
+        var counters = Counters()
+        counters.trackerCalls = 1
+        counters.cpuNanoseconds = (now.cpuNanoseconds &- usage.cpuNanoseconds) / count
+        if let before = usage.bytesInUse, let after = now.bytesInUse {
+            counters.bytes = UInt64(max(0, after - before)) * UInt64(EventCostProfiler.heapSampleInterval) / count
+        }
+
+        lock.lock()
+        for eventName in eventNames {
+            let cpuNanoseconds = add(counters, to: eventName)
+            update(eventName, cpuNanoseconds: cpuNanoseconds)
+        }
+        lock.unlock()
+    }
+
+    /// The costliest event names, by CPU time.
+    ///
+    /// - Parameter limit: The maximum number of event names.
+    func report(limit: Int) -> [EventCost] {
+        lock.lock()
+        let costs = heap.map { hitter -> EventCost in
+            let counters = estimate(hitter.eventName)
+            return EventCost(eventName: hitter.eventName,
+                             events: Int(counters.events),
+                             trackerCalls: Int(counters.trackerCalls),
+                             cpuTime: TimeInterval(counters.cpuNanoseconds) / 1_000_000_000,
+                             allocatedBytes: Int(counters.bytes))
+        }
+        lock.unlock()
+
+        return Array(costs.sorted { $0.cpuTime > $1.cpuTime }.prefix(limit))
+    }
+
+    // MARK: Sketch
+
+    /// The cells of an event name, one in each row. Derived from one hash by double hashing.
+    private func cells(for eventName: String) -> (first: UInt64, step: UInt64) {
+        let first = FNV1a.avalanche(FNV1a.hash64(eventName))
+        return (first, FNV1a.avalanche(first) | 1)
+    }
+
+    /// :nodoc:
+    private func cell(_ row: Int, of hash: (first: UInt64, step: UInt64)) -> Int {
+        let width = EventCostProfiler.width
+        return row * width + Int((hash.first &+ UInt64(row) &* hash.step) % UInt64(width))
+    }
+
+    /// Adds the counters to the cells of the name. Called with the lock held.
+    ///
+    /// - Returns: The estimate of the CPU time of the name after the update.
+    @discardableResult
+    private func add(_ counters: Counters, to eventName: String) -> UInt64 {
+        let hash = cells(for: eventName)
+        var cpuNanoseconds = UInt64.max
+        for row in 0..<EventCostProfiler.depth {
+            let index = cell(row, of: hash)
+            sketch[index].events &+= counters.events
+            sketch[index].trackerCalls &+= counters.trackerCalls
+            sketch[index].cpuNanoseconds &+= counters.cpuNanoseconds
+            sketch[index].bytes &+= counters.bytes
+            cpuNanoseconds = min(cpuNanoseconds, sketch[index].cpuNanoseconds)
+        }
+        return cpuNanoseconds
+    }
+
+    /// The estimate of each counter of a name, the minimum over its cells. Called with the lock held.
+    private func estimate(_ eventName: String) -> Counters {
+        let hash = cells(for: eventName)
+        var estimate = Counters(events: .max, trackerCalls: .max, cpuNanoseconds: .max, bytes: .max)
+        for row in 0..<EventCostProfiler.depth {
+            let counters = sketch[cell(row, of: hash)]
+            estimate.events = min(estimate.events, counters.events)
+            estimate.trackerCalls = min(estimate.trackerCalls, counters.trackerCalls)
+            estimate.cpuNanoseconds = min(estimate.cpuNanoseconds, counters.cpuNanoseconds)
+            estimate.bytes = min(estimate.bytes, counters.bytes)
+        }
+        return estimate
+    }
+
+    // MARK: Heap
+
+    /// Updates the CPU time of a name in the heap, or replaces the cheapest name with it. Called with the lock held.
+    private func update(_ eventName: String, cpuNanoseconds: UInt64) {
+        if let index = heapIndices[eventName] {
+            // The estimates only grow, so the name can only move down.
+            heap[index].cpuNanoseconds = cpuNanoseconds
+            siftDown(from: index)
+        } else if heap.count < capacity {
+            heap.append(HeavyHitter(eventName: eventName, cpuNanoseconds: cpuNanoseconds))
+            heapIndices[eventName] = heap.count - 1
+            siftUp(from: heap.count - 1)
+        } else if cpuNanoseconds > heap[0].cpuNanoseconds {
+            heapIndices[heap[0].eventName] = nil
+            heap[0] = HeavyHitter(eventName: eventName, cpuNanoseconds: cpuNanoseconds)
+            heapIndices[eventName] = 0
+            siftDown(from: 0)
+        }
+    }
+
+    /// :nodoc:
+    private func siftUp(from index: Int) {
+        var child = index
+        while child > 0 {
+            let parent = (child - 1) / 2
+            guard heap[child].cpuNanoseconds < heap[parent].cpuNanoseconds else { return }
+            swapAt(child, parent)
+            child = parent
+        }
+    }
+
+    /// :nodoc:
+    private func siftDown(from index: Int) {
+        var parent = index
+        while true {
+            let left = 2 * parent + 1
+            let right = left + 1
+            var smallest = parent
+            if left < heap.count && heap[left].cpuNanoseconds < heap[smallest].cpuNanoseconds {
+                smallest = left
+            }
+            if right < heap.count && heap[right].cpuNanoseconds < heap[smallest].cpuNanoseconds {
+                smallest = right
+            }
+            guard smallest != parent else { return }
+            swapAt(parent, smallest)
+            parent = smallest
+        }
+    }
+
+    /// :nodoc:
+    private func swapAt(_ first: Int, _ second: Int) {
+        heap.swapAt(first, second)
+        heapIndices[heap[first].eventName] = first
+        heapIndices[heap[second].eventName] = second
+    }
+}
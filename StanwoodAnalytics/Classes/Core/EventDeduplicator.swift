@@ -0,0 +1,122 @@
+//
+//  EventDeduplicator.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// Drops identical events that are tracked again within a time window.
+///
+/// The memory is fixed: a direct-mapped table of fingerprints and timestamps, indexed by the fingerprint.
+/// A new event evicts whatever was in its slot, so a collision can let a duplicate through but never drops
+/// an event that was not seen before (short of two different events with the same 64 bit fingerprint).
+final class EventDeduplicator {
+    private let window: UInt64
+    private let mask: Int
+    private var fingerprints: [UInt64]
+    private var timestamps: [UInt64]
+    private var duplicates = 0
+    private let lock = NSLock()
+
+    /// The number of events dropped as duplicates.
+    var duplicateCount: Int {
+        lock.lock()
+        defer { lock.unlock() }
+        return duplicates
+    }
+
+    /// Init with the window.
+    ///
+    /// - Parameters:
+    ///   - window: The time in seconds during which an identical event is a duplicate.
+    ///   - capacity: The number of slots, rounded up to a power of 2.
+    init(window: TimeInterval, capacity: Int = 256) {
+        var slots = 1
+        while slots < capacity {
+            slots <<= 1
+        }
+        self.window = UInt64(max(0, window) * 1_000_000_000)
+        mask = slots - 1
+        fingerprints = Array(repeating: 0, count: slots)
+        timestamps = Array(repeating: 0, count: slots)
+    }
+
+    /// Checks an event and remembers it.
+    ///
+    /// - Parameters:
+    ///   - fingerprint: The fingerprint of the event content.
+    ///   - now: The current time in nanoseconds.
+    /// - Returns: True if the same event was seen within the window. The event should be dropped.
+    func isDuplicate(_ fingerprint: UInt64, now: UInt64 = DispatchTime.now().uptimeNanoseconds) -> Bool {
+        let slot = Int(truncatingIfNeeded: fingerprint) & mask
+
+        lock.lock()
+        defer { lock.unlock() }
+
+        if fingerprints[slot] == fingerprint && now &- timestamps[slot] < window {
+            duplicates += 1
+            return true
+        }
+
+        fingerprints[slot] = fingerprint
+        timestamps[slot] = now
+        return false
+    }
+}
+
+// MARK: Fingerprints
+
+extension TrackingParameters {
+
+    /// A hash of the content of the event, used to detect duplicates.
+    var fingerprint: UInt64 {
+        var hash = FNV1a.hash64(eventName)
+        for field in [itemId, name, description, category, contentType] {
+            // The separator keeps a nil field apart from an empty one.
+            hash = FNV1a.hash64(field ?? "\u{0}", continuing: FNV1a.hash64("\u{1F}", continuing: hash))
+        }
+        return FNV1a.avalanche(hash ^ Fingerprint.combine(customValues))
+    }
+}
+
+extension TrackerKeys {
+
+    /// A hash of the content of the keys, used to detect duplicates.
+    var fingerprint: UInt64 {
+        return FNV1a.avalanche(Fingerprint.combine(values) ^ 0x6B65_7973) // "keys"
+    }
+}
+
+/// :nodoc:
+private enum Fingerprint {
+
+    /// An order independent hash of a dictionary, so the keys do not need to be sorted.
+    static func combine(_ dictionary: [String: TrackingValue]) -> UInt64 {
+        var combined: UInt64 = 0
+        for (key, value) in dictionary {
+            let pair = FNV1a.hash64(value.stringValue, continuing: FNV1a.hash64("\u{1F}", continuing: FNV1a.hash64(key)))
+            combined = combined &+ FNV1a.avalanche(pair)
+        }
+        return combined
+    }
+}
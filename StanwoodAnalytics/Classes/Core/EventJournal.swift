@@ -0,0 +1,504 @@
+//
+//  EventJournal.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// An append-only log of the events accepted by StanwoodAnalytics, shared by all the trackers.
+///
+/// Each record is stored once. Every tracker has its own durable cursor into the log, so trackers that consume
+/// at different speeds never duplicate the data, and a tracker continues from its own position after a restart.
+///
+/// The log is a sequence of memory-mapped segment files. Appending a record or moving a cursor is a copy into
+/// a mapping, so there is no system call on the tracking path. The mappings are synced to disk in groups on a
+/// background queue. A segment file is deleted once every cursor has moved past it.
+///
+/// Positions are logical byte offsets that only ever grow. A segment is named after the position of its first record.
+///
+/// Segment layout:
+///
+///     Header (16 bytes):  magic UInt32 | version UInt32 | base UInt64
+///     Record (16 bytes + payload):  length UInt32 | checksum UInt32 | position UInt64 | payload
+///
+/// Cursor file layout:
+///
+///     Header (8 bytes):  magic UInt32 | version UInt32
+///     Slot (16 bytes) x 64:  identifier hash UInt64 | position UInt64
+///
+/// A record is only valid if its stored position matches the expected position, so a torn write at the end of
+/// a segment is never replayed.
+final class EventJournal {
+
+    /// A record read back from the journal.
+    struct Record {
+        /// The position of the record.
+        let position: UInt64
+        /// The position directly after the record. Acknowledge this position once the record is delivered.
+        let endPosition: UInt64
+        /// The payload, pointing into the mapped segment. Only valid while the record is visited.
+        let payload: UnsafeRawBufferPointer
+    }
+
+    /// :nodoc:
+    private final class Segment {
+        let file: MappedFile
+        let base: UInt64
+        var end: UInt64
+
+        init(file: MappedFile, base: UInt64) {
+            self.file = file
+            self.base = base
+            end = base
+        }
+
+        func offset(of position: UInt64) -> Int {
+            return EventJournal.segmentHeaderSize + Int(position - base)
+        }
+    }
+
+    private static let segmentMagic: UInt32 = 0x4A41_5753 // "SWAJ"
+    private static let cursorMagic: UInt32 = 0x4341_5753 // "SWAC"
+    private static let version: UInt32 = 3
+    private static let segmentHeaderSize = 16
+    private static let recordHeaderSize = 16
+    private static let cursorHeaderSize = 8
+    private static let cursorSlotSize = 16
+    private static let cursorSlots = 64
+    private static let segmentExtension = "segment"
+
+    private let directory: URL
+    private let segmentSize: Int
+    private let maxSegments: Int
+    private let syncGroupSize: Int
+    private let cursorFile: MappedFile
+    private let lock = NSLock()
+    private let syncQueue = DispatchQueue(label: "io.stanwood.analytics.journal", qos: .utility)
+
+    private var segments: [Segment] = []
+    private var consumerPositions: [UInt64] = []
+    private var consumerSlots: [Int?] = []
+    private var truncatedPosition: UInt64 = 0
+    private var unsyncedRecords = 0
+    private var isSyncScheduled = false
+    private var hasWarnedFull = false
+
+    /// The default location in Application Support.
+    static var defaultDirectory: URL? {
+        guard let directory = FileManager.default.urls(for: .applicationSupportDirectory, in: .userDomainMask).first else { return nil }
+        return directory.appendingPathComponent("StanwoodAnalytics", isDirectory: true).appendingPathComponent("Journal", isDirectory: true)
+    }
+
+    /// The position after the last record.
+    var writePosition: UInt64 {
+        lock.lock()
+        defer { lock.unlock() }
+        return segments.last?.end ?? 0
+    }
+
+    /// Opens the journal, creating the directory and files if needed. Returns nil if the files cannot be created or mapped.
+    ///
+    /// - Parameters:
+    ///   - directory: The directory of the segment and cursor files.
+    ///   - segmentSize: The size of a segment file in bytes.
+    ///   - maxSegments: The maximum number of segment files. Events are not persisted while the limit is reached.
+    ///   - syncGroupSize: The number of records appended before the mappings are synced to disk.
+    init?(directory: URL, segmentSize: Int = 1 << 20, maxSegments: Int = 8, syncGroupSize: Int = 32) {
+        try? FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true, attributes: nil)
+
+        let cursorSize = EventJournal.cursorHeaderSize + EventJournal.cursorSlots * EventJournal.cursorSlotSize
+        guard let cursorFile = MappedFile(url: directory.appendingPathComponent("cursors"), size: cursorSize) else { return nil }
+
+        self.directory = directory
+        self.segmentSize = segmentSize
+        self.maxSegments = max(1, maxSegments)
+        self.syncGroupSize = max(1, syncGroupSize)
+        self.cursorFile = cursorFile
+
+        if cursorFile.load(UInt32.self, at: 0) != EventJournal.cursorMagic || cursorFile.load(UInt32.self, at: 4) != EventJournal.version {
+            cursorFile.clear()
+            cursorFile.store(EventJournal.cursorMagic, at: 0)
+            cursorFile.store(EventJournal.version, at: 4)
+        }
+
+        openSegments()
+
+        if segments.isEmpty {
+            guard let segment = makeSegment(base: 0) else { return nil }
+            segments.append(segment)
+        }
+        truncatedPosition = segments[0].base
+    }
+
+    // MARK: Consumers
+
+    /// Registers the consumers and loads their cursors. Cursors of consumers that are not registered are removed,
+    /// so a tracker that is no longer used does not keep the segments alive.
+    ///
+    /// - Parameter identifiers: A unique identifier for each consumer.
+    /// - Returns: The position each consumer continues from. A new consumer starts at the end of the log.
+    func register(consumers identifiers: [String]) -> [UInt64] {
+        lock.lock()
+        defer { lock.unlock() }
+
+        let end = segments.last?.end ?? 0
+        var hashes: [UInt64] = identifiers.map { max(1, FNV1a.hash64($0)) }
+        var slots: [Int?] = Array(repeating: nil, count: identifiers.count)
+        var positions: [UInt64] = Array(repeating: end, count: identifiers.count)
+
+        for slot in 0..<EventJournal.cursorSlots {
+            let offset = cursorOffset(of: slot)
+            let hash = cursorFile.load(UInt64.self, at: offset)
+            guard hash != 0 else { continue }
+
+            if let index = hashes.firstIndex(of: hash) {
+                slots[index] = slot
+                positions[index] = min(max(cursorFile.load(UInt64.self, at: offset + 8), truncatedPosition), end)
+                hashes[index] = 0
+            } else {
+                cursorFile.store(UInt64(0), at: offset)
+            }
+        }
+
+        for index in identifiers.indices where slots[index] == nil {
+            guard let slot = (0..<EventJournal.cursorSlots).first(where: { cursorFile.load(UInt64.self, at: cursorOffset(of: $0)) == 0 }) else {
+                print("StanwoodAnalytics Warning: The event journal supports \(EventJournal.cursorSlots) trackers. The cursor of \(identifiers[index]) is not persisted.")
+                continue
+            }
+            slots[index] = slot
+            cursorFile.store(max(1, FNV1a.hash64(identifiers[index])), at: cursorOffset(of: slot))
+            cursorFile.store(end, at: cursorOffset(of: slot) + 8)
+        }
+
+        consumerSlots = slots
+        consumerPositions = positions
+        return positions
+    }
+
+    /// Moves the cursor of a consumer forward, and removes the segments every cursor has moved past.
+    ///
+    /// - Parameters:
+    ///   - consumer: The index of the consumer.
+    ///   - position: The end position of the last record delivered to the consumer.
+    func acknowledge(consumer: Int, position: UInt64) {
+        lock.lock()
+        defer { lock.unlock() }
+
+        guard consumer < consumerPositions.count, position > consumerPositions[consumer] else { return }
+        consumerPositions[consumer] = position
+        if let slot = consumerSlots[consumer] {
+            cursorFile.store(position, at: cursorOffset(of: slot) + 8)
+        }
+
+        removeConsumedSegments()
+    }
+
+    // MARK: Records
+
+    /// Appends a record.
+    ///
+    /// - Parameter payload: The encoded event.
+    /// - Returns: The end position of the record, or nil if it cannot be persisted.
+    func append(_ payload: [UInt8]) -> UInt64? {
+        lock.lock()
+        defer { lock.unlock() }
+
+        let recordSize = EventJournal.recordHeaderSize + payload.count
+        guard EventJournal.segmentHeaderSize + recordSize <= segmentSize, var segment = segments.last else { return nil }
+
+        if segment.offset(of: segment.end) + recordSize > segmentSize {
+            guard segments.count < maxSegments, let next = makeSegment(base: segment.end) else {
+                if !hasWarnedFull {
+                    hasWarnedFull = true
+                    print("StanwoodAnalytics Warning: The event journal is full. Events are not persisted until the trackers catch up.")
+                }
+                return nil
+            }
+            segments.append(next)
+            segment = next
+        }
+
+        let position = segment.end
+        let offset = segment.offset(of: position)
+        let file = segment.file
+        payload.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+            file.copy(bytes, to: offset + EventJournal.recordHeaderSize)
+            file.store(FNV1a.hash32(bytes), at: offset + 4)
+        }
+        file.store(position, at: offset + 8)
+        // The length is written last, so a record is never visible before its payload.
+        file.store(UInt32(payload.count), at: offset)
+
+        segment.end = position + UInt64(recordSize)
+        hasWarnedFull = false
+        recordAppended()
+        return segment.end
+    }
+
+    /// Visits the records from a position to the end of the log, oldest first. The payloads are read in place
+    /// from the mapped segments. Do not call back into the journal from the closure.
+    ///
+    /// - Parameters:
+    ///   - position: The position to start from.
+    ///   - body: Called with each record.
+    func forEachRecord(from position: UInt64, _ body: (Record) -> Void) {
+        lock.lock()
+        defer { lock.unlock() }
+
+        for segment in segments where segment.end > position {
+            _ = scanRecords(in: segment) { record in
+                if record.position >= position {
+                    body(record)
+                }
+            }
+        }
+    }
+
+    /// Writes the mappings to disk and waits until it is done.
+    func sync() {
+        syncQueue.sync {
+            self.syncNow()
+        }
+    }
+
+    // MARK: Segments
+
+    /// Opens the existing segment files in order and finds the end of each. Called from init.
+    private func openSegments() {
+        let urls = (try? FileManager.default.contentsOfDirectory(at: directory, includingPropertiesForKeys: nil, options: [])) ?? []
+
+        let bases = urls
+            .filter { $0.pathExtension == EventJournal.segmentExtension }
+            .compactMap { UInt64($0.deletingPathExtension().lastPathComponent, radix: 16) }
+            .sorted()
+
+        for base in bases {
+            guard let file = MappedFile(url: segmentURL(base: base), size: segmentSize),
+                file.load(UInt32.self, at: 0) == EventJournal.segmentMagic,
+                file.load(UInt32.self, at: 4) == EventJournal.version,
+                file.load(UInt64.self, at: 8) == base else {
+                try? FileManager.default.removeItem(at: segmentURL(base: base))
+                continue
+            }
+
+            let segment = Segment(file: file, base: base)
+            segment.end = scanRecords(in: segment) { _ in }
+
+            // A gap means the segments in between are lost. Only the newest contiguous run is kept.
+            if let previous = segments.last, previous.end != base {
+                segments.forEach { $0.file.remove() }
+                segments.removeAll()
+            }
+            segments.append(segment)
+        }
+    }
+
+    /// :nodoc:
+    private func makeSegment(base: UInt64) -> Segment? {
+        guard let file = MappedFile(url: segmentURL(base: base), size: segmentSize) else { return nil }
+        file.store(EventJournal.segmentMagic, at: 0)
+        file.store(EventJournal.version, at: 4)
+        file.store(base, at: 8)
+        // Clear the first record header in case the file is reused.
+        file.store(UInt32(0), at: EventJournal.segmentHeaderSize)
+        return Segment(file: file, base: base)
+    }
+
+    /// Deletes the segments that every consumer has moved past. The active segment is always kept. Called with the lock held.
+    private func removeConsumedSegments() {
+        guard let consumed = consumerPositions.min() else { return }
+
+        while segments.count > 1, segments[0].end <= consumed {
+            let segment = segments.removeFirst()
+            truncatedPosition = segments[0].base
+            syncQueue.async {
+                segment.file.remove()
+            }
+        }
+    }
+
+    /// :nodoc:
+    private func segmentURL(base: UInt64) -> URL {
+        let name = String(format: "%016llx", base)
+        return directory.appendingPathComponent(name).appendingPathExtension(EventJournal.segmentExtension)
+    }
+
+    /// Walks the valid records of a segment. Called with the lock held, or from init.
+    ///
+    /// - Returns: The position after the last valid record.
+    private func scanRecords(in segment: Segment, _ body: (Record) -> Void) -> UInt64 {
+        let file = segment.file
+        var position = segment.base
+
+        while true {
+            let offset = segment.offset(of: position)
+            guard offset + EventJournal.recordHeaderSize <= segmentSize else { break }
+
+            let length = Int(file.load(UInt32.self, at: offset))
+            let payloadOffset = offset + EventJournal.recordHeaderSize
+            guard length > 0,
+                payloadOffset + length <= segmentSize,
+                file.load(UInt64.self, at: offset + 8) == position else { break }
+
+            let payload = file.bytes(at: payloadOffset, count: length)
+            guard FNV1a.hash32(payload) == file.load(UInt32.self, at: offset + 4) else { break }
+
+            let endPosition = position + UInt64(EventJournal.recordHeaderSize + length)
+            body(Record(position: position, endPosition: endPosition, payload: payload))
+            position = endPosition
+        }
+        return position
+    }
+
+    // MARK: Sync
+
+    /// :nodoc:
+    private func cursorOffset(of slot: Int) -> Int {
+        return EventJournal.cursorHeaderSize + slot * EventJournal.cursorSlotSize
+    }
+
+    /// :nodoc:
+    private func recordAppended() {
+        unsyncedRecords += 1
+
+        if unsyncedRecords >= syncGroupSize {
+            unsyncedRecords = 0
+            syncQueue.async { self.syncNow() }
+        } else if !isSyncScheduled {
+            // Records that do not fill a group are synced shortly after.
+            isSyncScheduled = true
+            syncQueue.asyncAfter(deadline: .now() + 1) {
+                self.lock.lock()
+                self.isSyncScheduled = false
+                self.unsyncedRecords = 0
+                self.lock.unlock()
+                self.syncNow()
+            }
+        }
+    }
+
+    /// Runs on the sync queue.
+    private func syncNow() {
+        lock.lock()
+        let files = segments.map { $0.file } + [cursorFile]
+        lock.unlock()
+
+        files.forEach { $0.sync() }
+    }
+}
+
+/// A file mapped into memory with read and write access.
+final class MappedFile {
+    let url: URL
+    let size: Int
+    private let fileDescriptor: Int32
+    private let mapping: UnsafeMutableRawPointer
+
+    /// Opens or creates the file and maps it. The file is resized to the size.
+    ///
+    /// - Parameters:
+    ///   - url: The file URL.
+    ///   - size: The size of the mapping in bytes.
+    init?(url: URL, size: Int) {
+        let descriptor = open(url.path, O_RDWR | O_CREAT, 0o600)
+        guard descriptor >= 0 else {
+            print("StanwoodAnalytics Error: The file cannot be opened at \(url.path).")
+            return nil
+        }
+
+        guard ftruncate(descriptor, off_t(size)) == 0,
+            let pointer = mmap(nil, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0),
+            pointer != UnsafeMutableRawPointer(bitPattern: -1) else {
+            print("StanwoodAnalytics Error: The file cannot be mapped at \(url.path).")
+            close(descriptor)
+            return nil
+        }
+
+        self.url = url
+        self.size = size
+        fileDescriptor = descriptor
+        mapping = pointer
+    }
+
+    deinit {
+        munmap(mapping, size)
+        close(fileDescriptor)
+    }
+
+    /// Reads a little endian integer.
+    func load<T: FixedWidthInteger>(_: T.Type, at offset: Int) -> T {
+        var value: T = 0
+        withUnsafeMutableBytes(of: &value) { $0.copyMemory(from: bytes(at: offset, count: MemoryLayout<T>.size)) }
+        return T(littleEndian: value)
+    }
+
+    /// Writes a little endian integer.
+    func store<T: FixedWidthInteger>(_ value: T, at offset: Int) {
+        var littleEndian = value.littleEndian
+        withUnsafeBytes(of: &littleEndian) { copy($0, to: offset) }
+    }
+
+    /// Copies bytes into the mapping.
+    func copy(_ source: UnsafeRawBufferPointer, to offset: Int) {
+        guard let address = source.baseAddress else { return }
+        (mapping + offset).copyMemory(from: address, byteCount: source.count)
+    }
+
+    /// The bytes of the mapping. Valid as long as the file is open.
+    func bytes(at offset: Int, count: Int) -> UnsafeRawBufferPointer {
+        return UnsafeRawBufferPointer(start: mapping + offset, count: count)
+    }
+
+    /// Sets all the bytes to zero.
+    func clear() {
+        memset(mapping, 0, size)
+    }
+
+    /// Writes the mapping to disk.
+    func sync() {
+        msync(mapping, size, MS_SYNC)
+    }
+
+    /// Deletes the file. The mapping stays valid until the object is released.
+    func remove() {
+        unlink(url.path)
+    }
+}
+
+// MARK: Encoding
+
+extension TrackerOperation {
+
+    /// The payload stored in the journal, in the EventRecord format. Start and setTracking are not journaled.
+    var journalPayload: [UInt8]? {
+        return EventRecord.encode(self)
+    }
+
+    /// Decodes an operation from a journal payload.
+    ///
+    /// - Parameter journalPayload: The payload written by journalPayload.
+    init?(journalPayload: UnsafeRawBufferPointer) {
+        guard let operation = EventRecord.decode(journalPayload) else { return nil }
+        self = operation
+    }
+}
@@ -0,0 +1,168 @@
+//
+//  EventRateLimiter.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// Limits the rate of each event name with a token bucket, and the number of each event name in a session.
+///
+/// The buckets live in a fixed table, so the memory does not grow with the number of event names and each check
+/// takes constant time. An event name takes the first free bucket of a short probe sequence starting at a slot
+/// given by its hash, and keeps it for the session, so its session count is never reset or shared with another name.
+/// When every bucket of the sequence belongs to another name, the event name shares an overflow bucket with the other
+/// names that found no bucket, so a flood of dynamically named events is still limited.
+///
+/// Suppressed events are collapsed into a single summary event with the number of suppressed events. It is
+/// sent before the next event with the same name that is allowed again, or when the analytics are flushed.
+final class EventRateLimiter {
+
+    /// The key of the suppressed count in the custom parameters of the summary event.
+    static let suppressedCountKey = "suppressed_count"
+
+    /// The number of buckets tried for an event name.
+    private static let probes = 8
+
+    /// The name of the overflow bucket in its summary event.
+    static let overflowEventName = "*"
+
+    /// :nodoc:
+    private struct Bucket {
+        var eventName: String?
+        var hash: UInt64 = 0
+        var tokens: Double
+        var refilledAt: UInt64 = 0
+        var sessionCount = 0
+        var suppressed = 0
+
+        init(tokens: Double) {
+            self.tokens = tokens
+        }
+    }
+
+    private let rate: Double
+    private let burst: Double
+    private let sessionCap: Int
+    private let mask: Int
+    /// The buckets of the event names, followed by the overflow bucket.
+    private var buckets: [Bucket]
+    private let lock = NSLock()
+
+    /// Init with the limits.
+    ///
+    /// - Parameters:
+    ///   - eventsPerSecond: The rate each bucket refills at.
+    ///   - burst: The maximum number of events of a name sent at once.
+    ///   - sessionCap: The maximum number of events of a name in the session. 0 means no cap.
+    ///   - capacity: The number of buckets, rounded up to a power of 2. It is the most event names that are limited.
+    init(eventsPerSecond: Double, burst: Int, sessionCap: Int, capacity: Int = 256) {
+        var slots = 1
+        while slots < capacity {
+            slots <<= 1
+        }
+        rate = max(0, eventsPerSecond) / 1_000_000_000
+        self.burst = Double(max(1, burst))
+        self.sessionCap = max(0, sessionCap)
+        mask = slots - 1
+        buckets = Array(repeating: Bucket(tokens: Double(max(1, burst))), count: slots + 1)
+        buckets[slots].eventName = EventRateLimiter.overflowEventName
+    }
+
+    /// Takes a token for an event.
+    ///
+    /// - Parameters:
+    ///   - eventName: The event name.
+    ///   - now: The current time in nanoseconds.
+    /// - Returns: Whether the event is allowed, and a summary of the events suppressed before it, if any.
+    func check(_ eventName: String, now: UInt64 = DispatchTime.now().uptimeNanoseconds) -> (allowed: Bool, summary: TrackingParameters?) {
+        let hash = FNV1a.avalanche(FNV1a.hash64(eventName))
+
+        lock.lock()
+        defer { lock.unlock() }
+
+        let slot = self.slot(of: eventName, hash: hash, now: now)
+        var bucket = buckets[slot]
+        bucket.tokens = min(burst, bucket.tokens + Double(now &- bucket.refilledAt) * rate)
+        bucket.refilledAt = now
+
+        var allowed = false
+        var summary: TrackingParameters?
+
+        if bucket.tokens >= 1 && (sessionCap == 0 || bucket.sessionCount < sessionCap) {
+            bucket.tokens -= 1
+            bucket.sessionCount += 1
+            summary = makeSummary(of: &bucket)
+            allowed = true
+        } else {
+            bucket.suppressed += 1
+        }
+
+        buckets[slot] = bucket
+        return (allowed, summary)
+    }
+
+    /// The bucket of an event name, taking a free bucket for a new name. Called with the lock held.
+    ///
+    /// - Returns: The slot of the bucket, or of the overflow bucket if the buckets of the probe sequence belong to other names.
+    private func slot(of eventName: String, hash: UInt64, now: UInt64) -> Int {
+        let start = Int(truncatingIfNeeded: hash)
+        for probe in 0..<EventRateLimiter.probes {
+            let slot = (start &+ probe) & mask
+            guard let owner = buckets[slot].eventName else {
+                buckets[slot].eventName = eventName
+                buckets[slot].hash = hash
+                buckets[slot].refilledAt = now
+                return slot
+            }
+            if buckets[slot].hash == hash && owner == eventName {
+                return slot
+            }
+        }
+        return mask + 1
+    }
+
+    /// Removes and returns the summaries of all the suppressed events.
+    func pendingSummaries() -> [TrackingParameters] {
+        lock.lock()
+        defer { lock.unlock() }
+
+        var summaries: [TrackingParameters] = []
+        for slot in buckets.indices where buckets[slot].suppressed > 0 {
+            if let summary = makeSummary(of: &buckets[slot]) {
+                summaries.append(summary)
+            }
+        }
+        return summaries
+    }
+
+    /// Builds the summary event and resets the suppressed count. Called with the lock held.
+    private func makeSummary(of bucket: inout Bucket) -> TrackingParameters? {
+        guard bucket.suppressed > 0, let eventName = bucket.eventName else { return nil }
+
+        var summary = TrackingParameters(eventName: StanwoodAnalytics.TrackingEvent.rateLimited.rawValue, name: eventName)
+        summary.customValues[EventRateLimiter.suppressedCountKey] = .int(bucket.suppressed)
+
+        bucket.suppressed = 0
+        return summary
+    }
+}
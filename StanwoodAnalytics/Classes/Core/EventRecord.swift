@@ -0,0 +1,475 @@
+//
+//  EventRecord.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// The compact binary encoding of the events stored in the journal.
+///
+/// A record is a kind, a field count and a list of tagged, length-prefixed fields:
+///
+///     Record:  version UInt8 | kind UInt8 | field count UInt16 | fields
+///     Field:   key tag UInt8 | [key length varint | key UTF-8 when the tag is inlineKey] | value type UInt8 | value
+///     Value:   string: length varint | UTF-8,  int: Int64,  double: Float64 bits,  bool: UInt8,  date: Float64 seconds since 1970
+///
+/// A record holds at most UInt16.max fields. The writer drops the custom values past the limit, so the count never wraps.
+///
+/// The fields of TrackingParameters and NSError, and the keys defined in StanwoodAnalytics.Keys, are stored as a
+/// one byte tag from a fixed key table instead of a string. Other keys are stored inline. Integers are little endian.
+///
+/// EventRecordReader reads the fields straight from the bytes, for example from the memory-mapped journal,
+/// without copying the record first. Strings are only created for the fields that are read.
+enum EventRecord {
+
+    static let version: UInt8 = 1
+
+    /// The kind of operation in a record.
+    enum Kind: UInt8 {
+        case parameters = 1
+        case keys = 2
+        case error = 3
+    }
+
+    /// The value types.
+    enum ValueType: UInt8 {
+        case string = 1
+        case int = 2
+        case double = 3
+        case bool = 4
+        case date = 5
+    }
+
+    /// The key table. The raw values are stored in records and must never change.
+    enum Tag: UInt8 {
+        // Fields of TrackingParameters and NSError.
+        case eventName = 1
+        case itemId = 2
+        case name = 3
+        case description = 4
+        case category = 5
+        case contentType = 6
+        case errorDomain = 7
+        case errorCode = 8
+
+        // Custom keys defined in StanwoodAnalytics.Keys.
+        case identifier = 32
+        case email = 33
+        case userName = 34
+        case screenName = 35
+        case screenClass = 36
+        case localizedDescription = 37
+
+        // A custom key stored inline.
+        case inlineKey = 255
+
+        /// The first tag of a custom key.
+        static let firstCustom: UInt8 = 32
+
+        /// The tag of a custom key from the key table.
+        init?(customKey: String) {
+            switch customKey {
+            case StanwoodAnalytics.Keys.identifier: self = .identifier
+            case StanwoodAnalytics.Keys.email: self = .email
+            case StanwoodAnalytics.Keys.userName: self = .userName
+            case StanwoodAnalytics.Keys.screenName: self = .screenName
+            case StanwoodAnalytics.Keys.screenClass: self = .screenClass
+            case StanwoodAnalytics.Keys.localizedDescription: self = .localizedDescription
+            default: return nil
+            }
+        }
+
+        /// The key of a custom key tag.
+        var customKey: String? {
+            switch self {
+            case .identifier: return StanwoodAnalytics.Keys.identifier
+            case .email: return StanwoodAnalytics.Keys.email
+            case .userName: return StanwoodAnalytics.Keys.userName
+            case .screenName: return StanwoodAnalytics.Keys.screenName
+            case .screenClass: return StanwoodAnalytics.Keys.screenClass
+            case .localizedDescription: return StanwoodAnalytics.Keys.localizedDescription
+            default: return nil
+            }
+        }
+    }
+
+    // MARK: Encoding
+
+    /// Encodes an operation. Start and setTracking are not encoded.
+    ///
+    /// - Parameter operation: The operation.
+    /// - Returns: The record, or nil for operations that are not stored.
+    static func encode(_ operation: TrackerOperation) -> [UInt8]? {
+        var writer: EventRecordWriter
+
+        switch operation {
+        case .parameters(let event):
+            let parameters = event.parameters
+            writer = EventRecordWriter(kind: .parameters)
+            writer.append(.eventName, string: parameters.eventName)
+            writer.append(.itemId, string: parameters.itemId)
+            writer.append(.name, string: parameters.name)
+            writer.append(.description, string: parameters.description)
+            writer.append(.category, string: parameters.category)
+            writer.append(.contentType, string: parameters.contentType)
+            writer.append(custom: parameters.customValues)
+        case .keys(let keys):
+            writer = EventRecordWriter(kind: .keys)
+            writer.append(custom: keys.values)
+        case .error(let error):
+            writer = EventRecordWriter(kind: .error)
+            writer.append(.errorDomain, string: error.domain)
+            writer.append(.errorCode, value: error.code)
+            writer.append(custom: error.userInfo)
+        case .start, .setTracking:
+            return nil
+        }
+
+        return writer.finish()
+    }
+
+    /// Decodes an operation.
+    ///
+    /// - Parameter bytes: The record. The bytes are not retained.
+    /// - Returns: The operation, or nil if the record is malformed.
+    static func decode(_ bytes: UnsafeRawBufferPointer) -> TrackerOperation? {
+        guard var reader = EventRecordReader(bytes: bytes) else { return nil }
+
+        var fields: [Tag: String] = [:]
+        var custom: [String: TrackingValue] = [:]
+        var errorCode: Int?
+
+        while let field = reader.next() {
+            if let key = field.customKey {
+                custom[key] = field.value.trackingValue
+            } else if field.tag == .errorCode, case .int(let code) = field.value {
+                errorCode = Int(code)
+            } else if let tag = field.tag, case .string = field.value {
+                fields[tag] = field.value.object as? String
+            }
+        }
+        guard reader.isValid else { return nil }
+
+        switch reader.kind {
+        case .parameters:
+            guard let eventName = fields[.eventName] else { return nil }
+            var parameters = TrackingParameters(eventName: eventName,
+                                                itemId: fields[.itemId],
+                                                name: fields[.name],
+                                                description: fields[.description],
+                                                category: fields[.category],
+                                                contentType: fields[.contentType])
+            parameters.customValues = custom
+            return .parameters(PreparedEvent(parameters))
+        case .keys:
+            var keys = TrackerKeys()
+            keys.values = custom
+            return .keys(keys)
+        case .error:
+            guard let domain = fields[.errorDomain], let code = errorCode else { return nil }
+            return .error(NSError(domain: domain, code: code, userInfo: custom.mapValues { $0.object }))
+        }
+    }
+}
+
+/// Writes a record into a single growing byte array.
+struct EventRecordWriter {
+    private var bytes: [UInt8] = []
+    private var count: UInt16 = 0
+    private var droppedCount = 0
+
+    init(kind: EventRecord.Kind) {
+        bytes.reserveCapacity(128)
+        bytes.append(EventRecord.version)
+        bytes.append(kind.rawValue)
+        bytes.append(0)
+        bytes.append(0)
+    }
+
+    /// Appends a string field. Nil values are skipped.
+    mutating func append(_ tag: EventRecord.Tag, string: String?) {
+        guard let string = string, hasRoom() else { return }
+        bytes.append(tag.rawValue)
+        appendValue(string)
+        count += 1
+    }
+
+    /// Appends a field with any supported value.
+    mutating func append(_ tag: EventRecord.Tag, value: Any) {
+        guard hasRoom() else { return }
+        bytes.append(tag.rawValue)
+        appendValue(value)
+        count += 1
+    }
+
+    /// Appends the entries of a custom dictionary.
+    mutating func append(custom dictionary: [String: Any]) {
+        for (key, value) in dictionary where hasRoom() {
+            appendKey(key)
+            appendValue(value)
+            count += 1
+        }
+    }
+
+    /// Appends the entries of a typed custom dictionary.
+    mutating func append(custom dictionary: [String: TrackingValue]) {
+        for (key, value) in dictionary where hasRoom() {
+            appendKey(key)
+            appendValue(value)
+            count += 1
+        }
+    }
+
+    /// The finished record.
+    mutating func finish() -> [UInt8] {
+        if droppedCount > 0 {
+            print("StanwoodAnalytics Warning: \(droppedCount) fields past the limit of \(UInt16.max) are not stored in the journal.")
+        }
+        bytes[2] = UInt8(truncatingIfNeeded: count)
+        bytes[3] = UInt8(truncatingIfNeeded: count >> 8)
+        return bytes
+    }
+
+    // MARK: Private
+
+    /// False, and counts the field as dropped, when the record holds the maximum number of fields.
+    private mutating func hasRoom() -> Bool {
+        guard count < UInt16.max else {
+            droppedCount += 1
+            return false
+        }
+        return true
+    }
+
+    /// :nodoc:
+    private mutating func appendKey(_ key: String) {
+        if let tag = EventRecord.Tag(customKey: key) {
+            bytes.append(tag.rawValue)
+        } else {
+            bytes.append(EventRecord.Tag.inlineKey.rawValue)
+            appendString(key)
+        }
+    }
+
+    /// :nodoc:
+    private mutating func appendValue(_ value: TrackingValue) {
+        switch value {
+        case .string(let string):
+            bytes.append(EventRecord.ValueType.string.rawValue)
+            appendString(string)
+        case .bool(let bool):
+            bytes.append(EventRecord.ValueType.bool.rawValue)
+            bytes.append(bool ? 1 : 0)
+        case .int(let int):
+            bytes.append(EventRecord.ValueType.int.rawValue)
+            appendInteger(UInt64(bitPattern: Int64(int)))
+        case .double(let double):
+            bytes.append(EventRecord.ValueType.double.rawValue)
+            appendInteger(double.bitPattern)
+        case .date(let date):
+            bytes.append(EventRecord.ValueType.date.rawValue)
+            appendInteger(date.timeIntervalSince1970.bitPattern)
+        case .other(let value):
+            // Only the description of other values is stored.
+            bytes.append(EventRecord.ValueType.string.rawValue)
+            appendString(String(describing: value))
+        }
+    }
+
+    /// :nodoc:
+    private mutating func appendValue(_ value: Any) {
+        appendValue(TrackingValue(value))
+    }
+
+    /// :nodoc:
+    private mutating func appendString(_ string: String) {
+        var length = UInt64(string.utf8.count)
+        // Unsigned LEB128 varint.
+        repeat {
+            let byte = UInt8(length & 0x7F)
+            length >>= 7
+            bytes.append(length == 0 ? byte : byte | 0x80)
+        } while length != 0
+        bytes.append(contentsOf: string.utf8)
+    }
+
+    /// :nodoc:
+    private mutating func appendInteger(_ value: UInt64) {
+        for shift in stride(from: 0, to: 64, by: 8) {
+            bytes.append(UInt8(truncatingIfNeeded: value >> UInt64(shift)))
+        }
+    }
+}
+
+/// A field read from a record. The key and string values point into the record bytes.
+struct EventRecordField {
+
+    /// A value. Strings are decoded when object is read.
+    enum Value {
+        case string(UnsafeRawBufferPointer)
+        case int(Int64)
+        case double(Double)
+        case bool(Bool)
+        case date(Date)
+
+        /// The typed value.
+        var trackingValue: TrackingValue {
+            switch self {
+            case .string(let bytes): return .string(String(decoding: bytes, as: UTF8.self))
+            case .int(let value): return .int(Int(value))
+            case .double(let value): return .double(value)
+            case .bool(let value): return .bool(value)
+            case .date(let value): return .date(value)
+            }
+        }
+
+        /// The value as a Swift object.
+        var object: Any {
+            switch self {
+            case .string(let bytes): return String(decoding: bytes, as: UTF8.self)
+            case .int(let value): return Int(value)
+            case .double(let value): return value
+            case .bool(let value): return value
+            case .date(let value): return value
+            }
+        }
+    }
+
+    /// The tag from the key table, or nil for an unknown tag.
+    let tag: EventRecord.Tag?
+    let rawTag: UInt8
+    let inlineKey: UnsafeRawBufferPointer?
+    let value: Value
+
+    /// The key of a custom dictionary entry, or nil for the fields of TrackingParameters and NSError.
+    var customKey: String? {
+        if let inlineKey = inlineKey {
+            return String(decoding: inlineKey, as: UTF8.self)
+        }
+        return rawTag >= EventRecord.Tag.firstCustom ? tag?.customKey : nil
+    }
+}
+
+/// Reads the fields of a record one by one, without copying the bytes.
+struct EventRecordReader {
+    let kind: EventRecord.Kind
+    private let bytes: UnsafeRawBufferPointer
+    private let fieldCount: Int
+    private var offset = 4
+    private var fieldsRead = 0
+    /// False once a malformed field has been found.
+    private(set) var isValid = true
+
+    /// Init with the record bytes. Returns nil if the header is invalid.
+    ///
+    /// - Parameter bytes: The record. Must stay valid while the reader and its fields are used.
+    init?(bytes: UnsafeRawBufferPointer) {
+        guard bytes.count >= 4, bytes[0] == EventRecord.version, let kind = EventRecord.Kind(rawValue: bytes[1]) else { return nil }
+        self.bytes = bytes
+        self.kind = kind
+        fieldCount = Int(bytes[2]) | Int(bytes[3]) << 8
+    }
+
+    /// The next field, or nil at the end of the record or on a malformed field.
+    mutating func next() -> EventRecordField? {
+        guard isValid, fieldsRead < fieldCount else { return nil }
+
+        guard let rawTag = readByte() else { return invalid() }
+
+        var inlineKey: UnsafeRawBufferPointer?
+        if rawTag == EventRecord.Tag.inlineKey.rawValue {
+            guard let key = readString() else { return invalid() }
+            inlineKey = key
+        }
+
+        guard let type = readByte().flatMap({ EventRecord.ValueType(rawValue: $0) }) else { return invalid() }
+
+        let value: EventRecordField.Value
+        switch type {
+        case .string:
+            guard let string = readString() else { return invalid() }
+            value = .string(string)
+        case .int:
+            guard let bits = readInteger() else { return invalid() }
+            value = .int(Int64(bitPattern: bits))
+        case .double:
+            guard let bits = readInteger() else { return invalid() }
+            value = .double(Double(bitPattern: bits))
+        case .bool:
+            guard let byte = readByte() else { return invalid() }
+            value = .bool(byte != 0)
+        case .date:
+            guard let bits = readInteger() else { return invalid() }
+            value = .date(Date(timeIntervalSince1970: Double(bitPattern: bits)))
+        }
+
+        fieldsRead += 1
+        return EventRecordField(tag: EventRecord.Tag(rawValue: rawTag), rawTag: rawTag, inlineKey: inlineKey, value: value)
+    }
+
+    // MARK: Private
+
+    /// :nodoc:
+    private mutating func invalid() -> EventRecordField? {
+        isValid = false
+        return nil
+    }
+
+    /// :nodoc:
+    private mutating func readByte() -> UInt8? {
+        guard offset < bytes.count else { return nil }
+        defer { offset += 1 }
+        return bytes[offset]
+    }
+
+    /// :nodoc:
+    private mutating func readInteger() -> UInt64? {
+        guard offset + 8 <= bytes.count else { return nil }
+        var value: UInt64 = 0
+        for index in 0..<8 {
+            value |= UInt64(bytes[offset + index]) << UInt64(index * 8)
+        }
+        offset += 8
+        return value
+    }
+
+    /// :nodoc:
+    private mutating func readString() -> UnsafeRawBufferPointer? {
+        var length = 0
+        var shift = 0
+        while true {
+            guard shift < 63, let byte = readByte() else { return nil }
+            length |= Int(byte & 0x7F) << shift
+            if byte & 0x80 == 0 {
+                break
+            }
+            shift += 7
+        }
+
+        guard length >= 0, offset + length <= bytes.count, let base = bytes.baseAddress else {
+            return length == 0 ? UnsafeRawBufferPointer(start: nil, count: 0) : nil
+        }
+        defer { offset += length }
+        return UnsafeRawBufferPointer(start: base + offset, count: length)
+    }
+}
@@ -0,0 +1,222 @@
+//
+//  EventRouter.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// Routes events to a subset of the trackers, following rules loaded from JSON.
+///
+///     {
+///         "rules": [
+///             { "event": "ecommerce_purchase", "only": ["Firebase"] },
+///             { "event": "debug", "drop": ["MixpanelTracker"] },
+///             { "event": "*", "drop": ["TestFairy"] }
+///         ]
+///     }
+///
+/// Trackers are named by their class name, with or without the Tracker suffix. The rules of the event "*" apply
+/// to every event, then the rules of the event itself apply in order. Event names are compared ignoring case.
+///
+/// The rules are compiled into a table from the case folded event symbol to a bitmask of the trackers, so routing
+/// an event is one dictionary lookup. Loading new rules builds a new immutable table and publishes it with an atomic
+/// store; tracking calls read the published table with an atomic load and never take a lock. A replaced table may
+/// still be read by a tracking call, so every table is kept until the router is released. Rules are only loaded a
+/// few times in a session, so these are few.
+final class EventRouter {
+
+    /// Every tracker.
+    static let all = UInt64.max
+
+    /// :nodoc:
+    private struct RuleFile: Decodable {
+        let rules: [Rule]
+    }
+
+    /// :nodoc:
+    private struct Rule: Decodable {
+        let event: String
+        let only: [String]?
+        let drop: [String]?
+    }
+
+    /// An immutable compiled rule set.
+    private final class Table {
+        let defaultRoutes: UInt64
+        let routesBySymbol: [UInt32: UInt64]
+        let routesByName: [String: UInt64]
+
+        init(defaultRoutes: UInt64, routesBySymbol: [UInt32: UInt64], routesByName: [String: UInt64]) {
+            self.defaultRoutes = defaultRoutes
+            self.routesBySymbol = routesBySymbol
+            self.routesByName = routesByName
+        }
+    }
+
+    private let trackerNames: [String]
+    /// The address of the published table, or 0 when there are no rules.
+    private let published: UnsafeMutablePointer<Int64>
+    /// Every table that was published, which keeps them alive. Guarded by lock.
+    private var tables: [Table] = []
+    /// Serialises the loads. Tracking calls do not take it.
+    private let lock = NSLock()
+
+    /// Init with the trackers.
+    ///
+    /// - Parameter trackerNames: The identifier of each tracker, in the order of the channels.
+    init(trackerNames: [String]) {
+        self.trackerNames = trackerNames
+        published = UnsafeMutablePointer<Int64>.allocate(capacity: 1)
+        published.initialize(to: 0)
+    }
+
+    deinit {
+        published.deallocate()
+    }
+
+    /// The trackers that receive an event, as a bitmask of the tracker indexes. Trackers after the 64th always receive it.
+    ///
+    /// - Parameter parameters: The event.
+    /// - Returns: The bitmask.
+    func routes(for parameters: TrackingParameters) -> UInt64 {
+        guard let routes = currentTable() else { return EventRouter.all }
+
+        if let symbol = parameters.eventSymbol {
+            return routes.routesBySymbol[symbol.folded.rawValue] ?? routes.defaultRoutes
+        }
+        return routes.routesByName[parameters.eventName.lowercased()] ?? routes.defaultRoutes
+    }
+
+    /// Compiles and loads rules. The current rules stay in place if the JSON is invalid.
+    ///
+    /// - Parameter data: The JSON rule file.
+    /// - Returns: True if the rules were loaded.
+    @discardableResult
+    func load(_ data: Data) -> Bool {
+        let ruleFile: RuleFile
+        do {
+            ruleFile = try JSONDecoder().decode(RuleFile.self, from: data)
+        } catch {
+            print("StanwoodAnalytics Error: The routing rules cannot be read: \(error)")
+            return false
+        }
+
+        publish(compile(ruleFile.rules))
+        return true
+    }
+
+    /// Removes the rules. Every event goes to every tracker.
+    func reset() {
+        publish(nil)
+    }
+
+    // MARK: Private
+
+    /// The published table, read with an atomic load.
+    private func currentTable() -> Table? {
+        let address = OSAtomicAdd64Barrier(0, published)
+        guard let pointer = UnsafeRawPointer(bitPattern: Int(truncatingIfNeeded: address)) else { return nil }
+        return Unmanaged<Table>.fromOpaque(pointer).takeUnretainedValue()
+    }
+
+    /// Publishes a table with an atomic store, keeping it alive for the readers.
+    private func publish(_ table: Table?) {
+        lock.lock()
+        defer { lock.unlock() }
+
+        var address: Int64 = 0
+        if let table = table {
+            tables.append(table)
+            address = Int64(Int(bitPattern: Unmanaged.passUnretained(table).toOpaque()))
+        }
+        // Only the loads store, and they hold the lock, so the swap cannot fail.
+        _ = OSAtomicCompareAndSwap64Barrier(published.pointee, address, published)
+    }
+
+    /// :nodoc:
+    private func compile(_ rules: [Rule]) -> Table {
+        var defaultRoutes = EventRouter.all
+        for rule in rules where rule.event == "*" {
+            defaultRoutes = apply(rule, to: defaultRoutes)
+        }
+
+        var routesByName: [String: UInt64] = [:]
+        for rule in rules where rule.event != "*" {
+            let name = rule.event.lowercased()
+            routesByName[name] = apply(rule, to: routesByName[name] ?? defaultRoutes)
+        }
+
+        var routesBySymbol = [UInt32: UInt64](minimumCapacity: routesByName.count)
+        for (name, routes) in routesByName {
+            if let symbol = Symbol(name) {
+                routesBySymbol[symbol.folded.rawValue] = routes
+            }
+        }
+
+        return Table(defaultRoutes: defaultRoutes, routesBySymbol: routesBySymbol, routesByName: routesByName)
+    }
+
+    /// :nodoc:
+    private func apply(_ rule: Rule, to routes: UInt64) -> UInt64 {
+        var routes = routes
+        if let only = rule.only {
+            // Trackers after the 64th cannot be excluded.
+            routes &= mask(of: only) | ~EventRouter.mask(below: trackerNames.count)
+        }
+        if let drop = rule.drop {
+            routes &= ~mask(of: drop)
+        }
+        return routes
+    }
+
+    /// The bitmask of the named trackers.
+    private func mask(of names: [String]) -> UInt64 {
+        var mask: UInt64 = 0
+        for name in names {
+            var found = false
+            for (index, trackerName) in trackerNames.enumerated() where index < 64 && matches(trackerName, name) {
+                mask |= 1 << UInt64(index)
+                found = true
+            }
+            if !found {
+                print("StanwoodAnalytics Warning: The routing rules name the tracker \(name), which is not added.")
+            }
+        }
+        return mask
+    }
+
+    /// Matches FirebaseTracker and FirebaseTracker#2 with Firebase or FirebaseTracker, and FirebaseTracker#2 with itself.
+    private func matches(_ trackerName: String, _ name: String) -> Bool {
+        if trackerName == name || trackerName == name + "Tracker" {
+            return true
+        }
+        guard let separator = trackerName.firstIndex(of: "#") else { return false }
+        let typeName = String(trackerName[..<separator])
+        return typeName == name || typeName == name + "Tracker"
+    }
+
+    /// :nodoc:
+    private static func mask(below count: Int) -> UInt64 {
+        return count >= 64 ? UInt64.max : (1 << UInt64(count)) - 1
+    }
+}
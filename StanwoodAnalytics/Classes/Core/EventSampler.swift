@@ -0,0 +1,96 @@
+//
+//  EventSampler.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// Sample rates by event name, between 0 (drop every event) and 1 (keep every event).
+struct SampleRates {
+    /// The rate for events without a rate of their own.
+    var defaultRate: Double = 1
+    var eventRates: [String: Double] = [:]
+
+    /// True if any event can be sampled out.
+    var isSampling: Bool {
+        return defaultRate < 1 || !eventRates.isEmpty
+    }
+
+    func rate(for eventName: String) -> Double {
+        return eventRates[eventName] ?? defaultRate
+    }
+
+    /// Set a rate. The rate is clamped to 0...1.
+    ///
+    /// - Parameters:
+    ///   - rate: The sample rate.
+    ///   - eventName: The event name, or nil to set the default rate.
+    mutating func set(_ rate: Double, for eventName: String?) {
+        let rate = min(max(rate, 0), 1)
+        if let eventName = eventName {
+            eventRates[eventName] = rate
+        } else {
+            defaultRate = rate
+        }
+    }
+}
+
+/// Deterministic event sampling.
+///
+/// Every user and event name pair is placed in a bucket between 0 and 1 by hashing the user identifier
+/// together with the event name. An event is kept when its bucket is below the sample rate. The same user
+/// always gets the same bucket for an event, so a user that is sampled out stays sampled out and the funnels
+/// are not biased. Until an identifier is tracked with StanwoodAnalytics.Keys.identifier, a random identifier
+/// for the session is used.
+final class EventSampler {
+    private let lock = NSLock()
+    private var identifierHash: UInt64
+
+    /// Init with a random identifier for the session.
+    init() {
+        identifierHash = FNV1a.hash64(UUID().uuidString)
+    }
+
+    /// Set the user identifier used for the sampling decision.
+    ///
+    /// - Parameter identifier: The user identifier.
+    func set(identifier: String) {
+        let hash = FNV1a.hash64(identifier)
+        lock.lock()
+        identifierHash = hash
+        lock.unlock()
+    }
+
+    /// The bucket of the current user for an event, between 0 and 1.
+    ///
+    /// - Parameter eventName: The event name.
+    func bucket(for eventName: String) -> Double {
+        lock.lock()
+        let seed = identifierHash
+        lock.unlock()
+
+        // The unit separator keeps "ab" + "c" and "a" + "bc" apart.
+        let hash = FNV1a.avalanche(FNV1a.hash64(eventName, continuing: FNV1a.hash64("\u{1F}", continuing: seed)))
+        return Double(hash >> 11) / Double(UInt64(1) << 53)
+    }
+}
@@ -0,0 +1,65 @@
+//
+//  Hashing.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// FNV-1a, a fast non-cryptographic hash. Used for checksums and to bucket events, never for security.
+enum FNV1a {
+    private static let offsetBasis32: UInt32 = 0x811C_9DC5
+    private static let prime32: UInt32 = 0x0100_0193
+    static let offsetBasis64: UInt64 = 0xCBF2_9CE4_8422_2325
+    private static let prime64: UInt64 = 0x0000_0100_0000_01B3
+
+    /// 32 bit hash of the bytes.
+    static func hash32(_ bytes: UnsafeRawBufferPointer) -> UInt32 {
+        var hash = offsetBasis32
+        for byte in bytes {
+            hash = (hash ^ UInt32(byte)) &* prime32
+        }
+        return hash
+    }
+
+    /// 64 bit hash of the UTF-8 bytes of the string, continuing from a previous hash.
+    ///
+    /// - Parameters:
+    ///   - string: The string to hash.
+    ///   - hash: The hash to continue from. Pass the result of a previous call to hash several strings together.
+    static func hash64(_ string: String, continuing hash: UInt64 = FNV1a.offsetBasis64) -> UInt64 {
+        var hash = hash
+        for byte in string.utf8 {
+            hash = (hash ^ UInt64(byte)) &* prime64
+        }
+        return hash
+    }
+
+    /// Mixes the bits of a hash so that every output bit depends on every input bit (the splitmix64 finalizer).
+    /// Use it before taking the high bits of an FNV hash.
+    static func avalanche(_ hash: UInt64) -> UInt64 {
+        var mixed = hash
+        mixed = (mixed ^ (mixed >> 30)) &* 0xBF58_476D_1CE4_E5B9
+        mixed = (mixed ^ (mixed >> 27)) &* 0x94D0_49BB_1331_11EB
+        return mixed ^ (mixed >> 31)
+    }
+}
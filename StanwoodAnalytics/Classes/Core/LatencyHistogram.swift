@@ -0,0 +1,189 @@
+//
+//  LatencyHistogram.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// The tracker calls that are timed.
+public enum TrackerCall: Int, CaseIterable {
+    case start
+    case trackParameters
+    case trackKeys
+    case trackError
+    case setTracking
+    /// A batch of events, delivered with track(batch:).
+    case trackBatch
+}
+
+/// The latency of one kind of call on a tracker, since the analytics were built or the statistics were last reset.
+///
+/// The percentiles are the upper bound of their histogram bucket, so they are at most 1/16 higher than the exact value.
+public struct LatencyStatistics {
+    /// The name of the tracker class.
+    public let trackerName: String
+    /// The call.
+    public let call: TrackerCall
+    /// The number of calls.
+    public let count: Int
+    /// The median duration in seconds.
+    public let p50: TimeInterval
+    /// The 99th percentile of the duration in seconds.
+    public let p99: TimeInterval
+    /// The longest duration in seconds.
+    public let max: TimeInterval
+}
+
+/// A log-linear histogram of durations in nanoseconds, in the style of HdrHistogram.
+///
+/// Each power of 2 is split into 16 linear buckets, so a bucket is at most 1/16 of its values wide. Durations up to
+/// 2^37 ns (about 2 minutes) have their own bucket, longer ones are counted in the last one. The memory is fixed,
+/// so recording a duration never allocates.
+struct LatencyHistogram {
+
+    /// :nodoc:
+    private static let subBucketBits = 4
+    /// :nodoc:
+    private static let subBucketCount = 1 << subBucketBits
+    /// The power of 2 of the last bucket.
+    private static let maximumExponent = 36
+    /// :nodoc:
+    static let bucketCount = (maximumExponent - subBucketBits + 2) * subBucketCount
+
+    private var counts: [Int]
+    /// The number of recorded durations.
+    private(set) var totalCount = 0
+    /// The longest recorded duration.
+    private(set) var maximum: UInt64 = 0
+
+    init() {
+        counts = Array(repeating: 0, count: LatencyHistogram.bucketCount)
+    }
+
+    /// Adds a duration.
+    ///
+    /// - Parameter nanoseconds: The duration.
+    mutating func record(_ nanoseconds: UInt64) {
+        counts[LatencyHistogram.bucket(for: nanoseconds)] += 1
+        totalCount += 1
+        maximum = Swift.max(maximum, nanoseconds)
+    }
+
+    /// Removes all the durations.
+    mutating func reset() {
+        for index in counts.indices {
+            counts[index] = 0
+        }
+        totalCount = 0
+        maximum = 0
+    }
+
+    /// The duration below which the percentile of the durations fall.
+    ///
+    /// - Parameter percentile: The percentile, between 0 and 100.
+    /// - Returns: The upper bound of the bucket of the percentile, or 0 when the histogram is empty.
+    func value(atPercentile percentile: Double) -> UInt64 {
+        guard totalCount > 0 else { return 0 }
+
+        let rank = Swift.max(1, Int((percentile / 100 * Double(totalCount)).rounded(.up)))
+        var seen = 0
+        for (index, count) in counts.enumerated() where count > 0 {
+            seen += count
+            if seen >= rank {
+                return Swift.min(LatencyHistogram.highestValue(inBucket: index), maximum)
+            }
+        }
+        return maximum
+    }
+
+    /// The bucket of a duration. The first 16 buckets hold one value each, then every power of 2 has 16 buckets.
+    static func bucket(for value: UInt64) -> Int {
+        guard value >= UInt64(subBucketCount) else { return Int(value) }
+
+        let clamped = Swift.min(value, (1 << UInt64(maximumExponent + 1)) - 1)
+        let exponent = 63 - clamped.leadingZeroBitCount
+        let subBucket = Int(clamped >> UInt64(exponent - subBucketBits))
+        return (exponent - subBucketBits + 1) * subBucketCount + subBucket - subBucketCount
+    }
+
+    /// The highest duration that falls into a bucket.
+    static func highestValue(inBucket index: Int) -> UInt64 {
+        guard index >= subBucketCount else { return UInt64(index) }
+
+        let exponent = index / subBucketCount + subBucketBits - 1
+        let subBucket = UInt64(index % subBucketCount + subBucketCount)
+        return ((subBucket + 1) << UInt64(exponent - subBucketBits)) - 1
+    }
+}
+
+/// Times the calls of a channel on its tracker, with a histogram for each kind of call.
+///
+/// The durations are recorded on the queue of the tracker, which is the only writer, so the lock is only contended
+/// while the statistics are read.
+final class LatencyRecorder {
+    private let trackerName: String
+    private var histograms: [LatencyHistogram]
+    private let lock = NSLock()
+
+    /// Init with the name of the tracker class.
+    init(trackerName: String) {
+        self.trackerName = trackerName
+        histograms = TrackerCall.allCases.map { _ in LatencyHistogram() }
+    }
+
+    /// Records the duration of a call.
+    ///
+    /// - Parameters:
+    ///   - call: The call.
+    ///   - duration: The duration in nanoseconds.
+    func record(_ call: TrackerCall, duration: UInt64) {
+        lock.lock()
+        histograms[call.rawValue].record(duration)
+        lock.unlock()
+    }
+
+    /// The statistics of the calls made at least once.
+    ///
+    /// - Parameter reset: Removes the recorded durations, so the next statistics cover the calls made after this one.
+    func statistics(reset: Bool) -> [LatencyStatistics] {
+        lock.lock()
+        let histograms = self.histograms
+        if reset {
+            for index in self.histograms.indices {
+                self.histograms[index].reset()
+            }
+        }
+        lock.unlock()
+
+        return TrackerCall.allCases.compactMap { call in
+            let histogram = histograms[call.rawValue]
+            guard histogram.totalCount > 0 else { return nil }
+            return LatencyStatistics(trackerName: trackerName,
+                                     call: call,
+                                     count: histogram.totalCount,
+                                     p50: TimeInterval(histogram.value(atPercentile: 50)) / 1_000_000_000,
+                                     p99: TimeInterval(histogram.value(atPercentile: 99)) / 1_000_000_000,
+                                     max: TimeInterval(histogram.maximum) / 1_000_000_000)
+        }
+    }
+}
@@ -0,0 +1,184 @@
+//
+//  LaunchReport.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// The cost of one step of setting up the analytics.
+public struct LaunchCost {
+
+    /// The steps that are measured.
+    public enum Phase: String {
+        /// StanwoodAnalytics.Builder.build().
+        case analyticsBuild = "analytics_build"
+        /// The build() of a tracker builder, which runs the init of the tracker and the set up of the vendor framework.
+        case trackerInit = "tracker_init"
+        /// The start() of a tracker.
+        case start
+    }
+
+    /// The step.
+    public let phase: Phase
+    /// The name of the tracker class, or StanwoodAnalytics.
+    public let name: String
+    /// The time the step took, in seconds.
+    public let wallTime: TimeInterval
+    /// The CPU time of the thread that ran the step, in seconds. Work the framework hands to other threads is not included.
+    public let cpuTime: TimeInterval
+    /// The time from the start of the process to the start of the step, in seconds.
+    public let offset: TimeInterval
+    /// True when the step ran on the main thread, and so delayed the launch.
+    public let isMainThread: Bool
+    /// True when the step ran inside another step, for example a start() called in the init of a tracker.
+    /// Its time is already part of the outer step.
+    public let isNested: Bool
+}
+
+/// The launch costs of the analytics, in the order the steps started.
+public struct LaunchReport: CustomStringConvertible {
+
+    /// The measured steps.
+    public let costs: [LaunchCost]
+
+    /// The time spent on the main thread by the steps that are not nested, in seconds.
+    public var mainThreadWallTime: TimeInterval {
+        return costs.filter { $0.isMainThread && !$0.isNested }.reduce(0) { $0 + $1.wallTime }
+    }
+
+    /// The time spent by a tracker, in the steps that are not nested, in seconds.
+    ///
+    /// - Parameter name: The name of the tracker class.
+    public func wallTime(of name: String) -> TimeInterval {
+        return costs.filter { $0.name == name && !$0.isNested }.reduce(0) { $0 + $1.wallTime }
+    }
+
+    public var description: String {
+        var lines = costs.map { cost -> String in
+            let indent = cost.isNested ? "  " : ""
+            let thread = cost.isMainThread ? "main thread" : "background"
+            return indent + String(format: "%@ %@: %.2f ms wall, %.2f ms CPU, %@, at %.3f s",
+                                   cost.name, cost.phase.rawValue, cost.wallTime * 1000, cost.cpuTime * 1000, thread, cost.offset)
+        }
+        lines.append(String(format: "Main thread total: %.2f ms", mainThreadWallTime * 1000))
+        return lines.joined(separator: "\n")
+    }
+}
+
+/// Records the launch costs of the process, for StanwoodAnalytics.launchReport().
+///
+/// The steps are measured whenever they run, not only at launch, and the first 256 are kept.
+enum LaunchRecorder {
+
+    /// A measured step, with the uptime and thread needed to find the nested steps.
+    private struct Entry {
+        let phase: LaunchCost.Phase
+        let name: String
+        let start: UInt64
+        let end: UInt64
+        let cpuTime: UInt64
+        let offset: TimeInterval
+        let threadId: UInt32
+        let isMainThread: Bool
+    }
+
+    /// :nodoc:
+    private static let capacity = 256
+    /// :nodoc:
+    private static let lock = NSLock()
+    /// :nodoc:
+    private static var entries: [Entry] = []
+
+    /// The time the process started, read from the kernel.
+    private static let processStartDate: Date? = {
+        var info = kinfo_proc()
+        var size = MemoryLayout<kinfo_proc>.stride
+        var name: [Int32] = [CTL_KERN, KERN_PROC, KERN_PROC_PID, getpid()]
+        guard sysctl(&name, u_int(name.count), &info, &size, nil, 0) == 0 else { return nil }
+        let start = info.kp_proc.p_un.__p_starttime
+        return Date(timeIntervalSince1970: TimeInterval(start.tv_sec) + TimeInterval(start.tv_usec) / 1_000_000)
+    }()
+
+    /// The CPU time of the current thread in nanoseconds.
+    static func threadCPUTime() -> UInt64 {
+        return clock_gettime_nsec_np(CLOCK_THREAD_CPUTIME_ID)
+    }
+
+    /// Runs a step and records its cost. The name is the class of the result.
+    ///
+    /// - Parameters:
+    ///   - phase: The step.
+    ///   - make: Runs the step.
+    /// - Returns: The result of the step.
+    static func measure<Result: AnyObject>(_ phase: LaunchCost.Phase, _ make: () -> Result) -> Result {
+        let cpuStart = threadCPUTime()
+        let start = DispatchTime.now().uptimeNanoseconds
+        let result = make()
+        let end = DispatchTime.now().uptimeNanoseconds
+        record(phase, name: String(describing: type(of: result)), start: start, end: end, cpuTime: threadCPUTime() &- cpuStart)
+        return result
+    }
+
+    /// Records a step that has just ended on the current thread.
+    ///
+    /// - Parameters:
+    ///   - phase: The step.
+    ///   - name: The name of the tracker class, or StanwoodAnalytics.
+    ///   - start: The uptime in nanoseconds when the step started.
+    ///   - end: The uptime in nanoseconds when the step ended.
+    ///   - cpuTime: The CPU time of the step in nanoseconds.
+    static func record(_ phase: LaunchCost.Phase, name: String, start: UInt64, end: UInt64, cpuTime: UInt64) {
+        let wallTime = TimeInterval(end &- start) / 1_000_000_000
+        let offset = processStartDate.map { Date().timeIntervalSince($0) - wallTime } ?? 0
+        let entry = Entry(phase: phase, name: name, start: start, end: end, cpuTime: cpuTime, offset: offset,
+                          threadId: pthread_mach_thread_np(pthread_self()), isMainThread: Thread.isMainThread)
+
+        lock.lock()
+        if entries.count < capacity {
+            entries.append(entry)
+        }
+        lock.unlock()
+    }
+
+    /// The recorded steps, in the order they started.
+    static func report() -> LaunchReport {
+        lock.lock()
+        let entries = self.entries.sorted { $0.start < $1.start }
+        lock.unlock()
+
+        let costs = entries.map { entry -> LaunchCost in
+            let isNested = entries.contains { outer in
+                outer.threadId == entry.threadId && outer.start <= entry.start && entry.end <= outer.end
+                    && (outer.start, outer.end) != (entry.start, entry.end)
+            }
+            return LaunchCost(phase: entry.phase,
+                              name: entry.name,
+                              wallTime: TimeInterval(entry.end &- entry.start) / 1_000_000_000,
+                              cpuTime: TimeInterval(entry.cpuTime) / 1_000_000_000,
+                              offset: entry.offset,
+                              isMainThread: entry.isMainThread,
+                              isNested: isNested)
+        }
+        return LaunchReport(costs: costs)
+    }
+}
@@ -0,0 +1,215 @@
+//
+//  MappingPlan.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// A declarative description of how tracking parameters map to the keys of a framework.
+///
+/// Unlike a custom ParameterMapper, a plan is only data. Trackers compile it once when they are built into a
+/// flat list of steps, and each event then goes through a single loop over the steps. A plan is also a
+/// ParameterMapper, so it can be passed wherever a mapper is expected:
+///
+///     let plan = MappingPlan()
+///         .map(.itemId, to: AnalyticsParameterItemID)
+///         .map(.name, to: AnalyticsParameterItemName, transform: .truncated(100))
+///         .map(.custom("price"), to: AnalyticsParameterPrice)
+///
+///     FirebaseTracker.FirebaseBuilder(context: application).add(mapper: plan)
+public struct MappingPlan: ParameterMapper {
+
+    /// A field of the tracking parameters.
+    public enum Field {
+        case eventName
+        case itemId
+        case name
+        case description
+        case category
+        case contentType
+        /// A custom parameter. Values other than strings are mapped as their stringValue.
+        case custom(String)
+    }
+
+    /// A change applied to the value before it is stored under the framework key.
+    public enum Transform {
+        case lowercased
+        case uppercased
+        /// Keeps the first characters of the value.
+        case truncated(Int)
+        /// Any other change. Returning nil leaves the key out.
+        case custom((String) -> String?)
+
+        /// Applies the transform.
+        func apply(to value: String) -> String? {
+            switch self {
+            case .lowercased:
+                return value.lowercased()
+            case .uppercased:
+                return value.uppercased()
+            case .truncated(let length):
+                return value.count > length ? String(value.prefix(max(0, length))) : value
+            case .custom(let transform):
+                return transform(value)
+            }
+        }
+    }
+
+    /// :nodoc:
+    struct Rule {
+        let field: Field
+        let key: String
+        let transform: Transform?
+    }
+
+    /// :nodoc:
+    private(set) var rules: [Rule] = []
+
+    /// The plan compiled when it was made, so mapping with the plan itself does not compile it.
+    private var compiled: CompiledMappingPlan?
+
+    /// Init an empty plan.
+    public init() {
+        compiled = CompiledMappingPlan(plan: self)
+    }
+
+    /// Adds a mapping. Returns a new plan so that it can be chained. A nil field value leaves the key out.
+    ///
+    /// - Parameters:
+    ///   - field: The field of the tracking parameters.
+    ///   - key: The key of the framework.
+    ///   - transform: An optional change applied to the value.
+    /// - Returns: The plan with the mapping added.
+    public func map(_ field: Field, to key: String, transform: Transform? = nil) -> MappingPlan {
+        var plan = self
+        plan.rules.append(Rule(field: field, key: key, transform: transform))
+        plan.compiled = CompiledMappingPlan(plan: plan)
+        return plan
+    }
+
+    /// The compiled plan. It is compiled once for each plan, so every call returns the same instance.
+    ///
+    /// - Returns: The compiled plan.
+    public func compile() -> CompiledMappingPlan {
+        return compiled ?? CompiledMappingPlan(plan: self)
+    }
+
+    /// Maps the parameters with the compiled plan.
+    ///
+    /// - Parameter parameters: The tracking parameters.
+    /// - Returns: The mapped values.
+    public func map(parameters: TrackingParameters) -> [String: NSString] {
+        return compile().map(parameters: parameters)
+    }
+}
+
+/// A mapping plan compiled to a flat list of steps.
+///
+/// Each step holds the index of the field, the framework key and the transform, so mapping an event only reads
+/// fields by index and stores the values in a dictionary sized up front.
+public final class CompiledMappingPlan: ParameterMapper {
+
+    /// :nodoc:
+    private struct Step {
+        let field: Int
+        let customKey: String?
+        let key: String
+        let transform: MappingPlan.Transform?
+    }
+
+    /// The index of custom parameter fields.
+    static let customField = -1
+
+    private let steps: ContiguousArray<Step>
+
+    /// :nodoc:
+    init(plan: MappingPlan) {
+        steps = ContiguousArray(plan.rules.map { rule -> Step in
+            let (field, customKey) = CompiledMappingPlan.index(of: rule.field)
+            return Step(field: field, customKey: customKey, key: rule.key, transform: rule.transform)
+        })
+    }
+
+    /// Maps the parameters.
+    ///
+    /// - Parameter parameters: The tracking parameters.
+    /// - Returns: The mapped values.
+    public func map(parameters: TrackingParameters) -> [String: NSString] {
+        var keyValues = [String: NSString](minimumCapacity: steps.count)
+
+        for step in steps {
+            guard let value = CompiledMappingPlan.value(at: step.field, customKey: step.customKey, in: parameters) else { continue }
+
+            if let transform = step.transform {
+                if let transformed = transform.apply(to: value) {
+                    keyValues[step.key] = NSString(string: transformed)
+                }
+            } else {
+                keyValues[step.key] = NSString(string: value)
+            }
+        }
+
+        return keyValues
+    }
+
+    /// The index of a field, and the key of custom parameters.
+    static func index(of field: MappingPlan.Field) -> (Int, String?) {
+        switch field {
+        case .eventName:
+            return (0, nil)
+        case .itemId:
+            return (1, nil)
+        case .name:
+            return (2, nil)
+        case .description:
+            return (3, nil)
+        case .category:
+            return (4, nil)
+        case .contentType:
+            return (5, nil)
+        case .custom(let key):
+            return (customField, key)
+        }
+    }
+
+    /// The value of a field by index.
+    static func value(at field: Int, customKey: String?, in parameters: TrackingParameters) -> String? {
+        switch field {
+        case 0:
+            return parameters.eventName
+        case 1:
+            return parameters.itemId
+        case 2:
+            return parameters.name
+        case 3:
+            return parameters.description
+        case 4:
+            return parameters.category
+        case 5:
+            return parameters.contentType
+        default:
+            guard let customKey = customKey else { return nil }
+            return parameters.customValues[customKey]?.stringValue
+        }
+    }
+}
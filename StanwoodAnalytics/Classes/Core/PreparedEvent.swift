@@ -0,0 +1,198 @@
+//
+//  PreparedEvent.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// An event as it is handed to the trackers, with the forms derived from it.
+///
+/// StanwoodAnalytics prepares each event once and every tracker receives the same object. The derived forms
+/// are computed the first time a tracker asks for them and cached, so fanning an event out to several trackers
+/// converts it once instead of once per tracker. The trackers run on their own queues, so the cache is
+/// protected by a lock. The forms are computed outside the lock; two trackers asking at the same time may
+/// both compute a form, and the first one stored wins.
+public final class PreparedEvent {
+
+    /// The tracking parameters of the event.
+    public let parameters: TrackingParameters
+
+    /// Records the mapping, when tracing is enabled.
+    private let tracer: TraceRecorder?
+    private let lock = NSLock()
+    private var cachedDebugInfo: String?
+    private var cachedPayload: [String: String]?
+    private var cachedProperties: [String: String]?
+    private var cachedLogMessage: String?
+    private var cachedViews: [ObjectIdentifier: Any] = [:]
+
+    /// Init with the tracking parameters.
+    ///
+    /// - Parameter parameters: The tracking parameters.
+    public init(_ parameters: TrackingParameters) {
+        self.parameters = parameters
+        tracer = nil
+    }
+
+    /// Init with the tracking parameters and the recorder of the trace.
+    init(_ parameters: TrackingParameters, tracer: TraceRecorder?) {
+        self.parameters = parameters
+        self.tracer = tracer
+    }
+
+    /// The info displayed for the local notification when debugging tracking. See TrackingParameters.debugInfo().
+    public var debugInfo: String {
+        return cached(\.cachedDebugInfo) { $0.debugInfo() }
+    }
+
+    /// The payload of the notification posted to the debugger. See TrackingParameters.payload().
+    public var payload: [String: String] {
+        return cached(\.cachedPayload) { $0.payload() }
+    }
+
+    /// All the non-nil parameters and the string custom parameters, as strings.
+    ///
+    /// The keys are EventName, Name, ItemId, ContentType, Category and Description, followed by the custom keys.
+    public var properties: [String: String] {
+        return cached(\.cachedProperties) { parameters in
+            var properties: [String: String] = ["EventName": parameters.eventName]
+
+            if let name = parameters.name {
+                properties["Name"] = name
+            }
+
+            if let itemId = parameters.itemId {
+                properties["ItemId"] = itemId
+            }
+
+            if let contentType = parameters.contentType {
+                properties["ContentType"] = contentType
+            }
+
+            if let category = parameters.category {
+                properties["Category"] = category
+            }
+
+            if let description = parameters.description {
+                properties["Description"] = description
+            }
+
+            for (key, value) in parameters.customValues {
+                if case .string(let string) = value {
+                    properties[key] = string
+                }
+            }
+
+            return properties
+        }
+    }
+
+    /// A one line log message with the event name, name and item id.
+    public var logMessage: String {
+        return cached(\.cachedLogMessage) { parameters in
+            return "Event: \(String(describing: parameters.eventName)) "
+                + "Name: \(String(describing: parameters.name)) "
+                + "ItemId: \(String(describing: parameters.itemId))"
+        }
+    }
+
+    /// The parameters mapped by a parameter mapper.
+    ///
+    /// The result is cached by the instance of the mapper, so trackers sharing a mapper share the result, and
+    /// mappers of the same type configured differently do not. Mappers that are structs or enums have no
+    /// identity and are not cached. A mapping plan is cached by its compiled plan.
+    ///
+    /// - Parameter mapper: The parameter mapper.
+    /// - Returns: The mapped parameters.
+    public func mapped(by mapper: ParameterMapper) -> [String: NSString] {
+        if let plan = mapper as? MappingPlan {
+            return mapped(by: plan.compile())
+        }
+        if let plan = mapper as? CompiledMappingPlan {
+            return view(for: ObjectIdentifier(plan)) { map($0, with: plan) }
+        }
+        if !(type(of: mapper) is AnyClass) {
+            return map(parameters, with: mapper)
+        }
+        return view(for: ObjectIdentifier(mapper as AnyObject)) { map($0, with: mapper) }
+    }
+
+    /// Maps the parameters, and records the mapping when tracing.
+    private func map(_ parameters: TrackingParameters, with mapper: ParameterMapper) -> [String: NSString] {
+        guard let tracer = tracer else {
+            return mapper.map(parameters: parameters)
+        }
+
+        let start = DispatchTime.now().uptimeNanoseconds
+        let mapped = mapper.map(parameters: parameters)
+        tracer.record(.mapping, name: "\(type(of: mapper)) \(parameters.eventName)", start: start)
+        return mapped
+    }
+
+    /// A form of the event, computed once for each key.
+    ///
+    /// Trackers can cache their own form of the event here, using for example the type of the tracker as the key.
+    ///
+    /// - Parameters:
+    ///   - key: Identifies the form.
+    ///   - make: Computes the form from the tracking parameters.
+    /// - Returns: The cached form.
+    public func view<View>(for key: ObjectIdentifier, _ make: (TrackingParameters) -> View) -> View {
+        lock.lock()
+        let cachedView = cachedViews[key] as? View
+        lock.unlock()
+
+        if let cachedView = cachedView {
+            return cachedView
+        }
+
+        let view = make(parameters)
+        lock.lock()
+        defer { lock.unlock() }
+        if let storedView = cachedViews[key] as? View {
+            return storedView
+        }
+        cachedViews[key] = view
+        return view
+    }
+
+    /// :nodoc:
+    private func cached<Value>(_ slot: ReferenceWritableKeyPath<PreparedEvent, Value?>, _ make: (TrackingParameters) -> Value) -> Value {
+        lock.lock()
+        let cachedValue = self[keyPath: slot]
+        lock.unlock()
+
+        if let cachedValue = cachedValue {
+            return cachedValue
+        }
+
+        let value = make(parameters)
+        lock.lock()
+        defer { lock.unlock() }
+        if let storedValue = self[keyPath: slot] {
+            return storedValue
+        }
+        self[keyPath: slot] = value
+        return value
+    }
+}
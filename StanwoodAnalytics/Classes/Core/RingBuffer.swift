@@ -0,0 +1,130 @@
+//
+//  RingBuffer.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// A fixed capacity first-in first-out buffer. The storage is allocated once in the init and only grows when grow() is called.
+struct RingBuffer<Element> {
+    private var storage: ContiguousArray<Element?>
+    private var head = 0
+    private(set) var count = 0
+
+    /// The maximum number of elements.
+    var capacity: Int {
+        return storage.count
+    }
+
+    var isEmpty: Bool {
+        return count == 0
+    }
+
+    var isFull: Bool {
+        return count == storage.count
+    }
+
+    /// Init with the capacity.
+    ///
+    /// - Parameter capacity: The maximum number of elements. Must be greater than 0.
+    init(capacity: Int) {
+        precondition(capacity > 0, "StanwoodAnalytics Error: The buffer capacity must be greater than 0.")
+        storage = ContiguousArray(repeating: nil, count: capacity)
+    }
+
+    /// The oldest element, without removing it.
+    var first: Element? {
+        return count > 0 ? storage[head] : nil
+    }
+
+    /// Append an element at the end. The buffer must not be full.
+    ///
+    /// - Parameter element: The element to append.
+    mutating func push(_ element: Element) {
+        assert(!isFull)
+        storage[(head + count) % storage.count] = element
+        count += 1
+    }
+
+    /// Remove the oldest element.
+    ///
+    /// - Returns: The oldest element, or nil when the buffer is empty.
+    @discardableResult
+    mutating func pop() -> Element? {
+        guard count > 0 else { return nil }
+        let element = storage[head]
+        storage[head] = nil
+        head = (head + 1) % storage.count
+        count -= 1
+        return element
+    }
+
+    /// The element at an offset from the oldest one.
+    subscript(offset: Int) -> Element {
+        get {
+            guard offset >= 0 && offset < count, let element = storage[(head + offset) % storage.count] else {
+                preconditionFailure("StanwoodAnalytics Error: The offset is out of the buffer.")
+            }
+            return element
+        }
+        set {
+            precondition(offset >= 0 && offset < count)
+            storage[(head + offset) % storage.count] = newValue
+        }
+    }
+
+    /// The offset from the oldest element of the first element that satisfies the predicate.
+    func firstOffset(where predicate: (Element) -> Bool) -> Int? {
+        for offset in 0..<count where predicate(self[offset]) {
+            return offset
+        }
+        return nil
+    }
+
+    /// Remove the element at an offset from the oldest one. The older elements are moved up by one,
+    /// so the cost is in the offset.
+    ///
+    /// - Parameter offset: The offset, less than count.
+    /// - Returns: The removed element.
+    @discardableResult
+    mutating func remove(at offset: Int) -> Element {
+        let element = self[offset]
+        for index in stride(from: offset, to: 0, by: -1) {
+            storage[(head + index) % storage.count] = storage[(head + index - 1) % storage.count]
+        }
+        storage[head] = nil
+        head = (head + 1) % storage.count
+        count -= 1
+        return element
+    }
+
+    /// Double the capacity, keeping the elements in order.
+    mutating func grow() {
+        var grown = ContiguousArray<Element?>(repeating: nil, count: storage.count * 2)
+        for offset in 0..<count {
+            grown[offset] = storage[(head + offset) % storage.count]
+        }
+        storage = grown
+        head = 0
+    }
+}
@@ -41,13 +41,39 @@ public protocol ParameterMapper {
 open class StanwoodAnalytics {
 
     // MARK: Properties
-    /// :nodoc:
+    /// Read by every tracking call, from any thread. Guarded by stateLock.
     private var trackingEnable: Bool = false
     /// :nodoc:
-    private var trackers: [Tracker] = []
+    private let stateLock = NSLock()
+    /// Serialises setTracking, so that the trackers are started once when tracking is turned on.
+    private let consentLock = NSLock()
+    /// :nodoc:
+    private let trackers: [Tracker]
+    /// :nodoc:
+    private let channels: [TrackerChannel]
+    /// The channels that handle each combination of capabilities, indexed by the raw value.
+    private let dispatchTable: [[TrackerChannel]]
+    /// :nodoc:
+    private let journal: EventJournal?
+    /// Records the spans of the pipeline, when tracing is enabled.
+    private let tracer: TraceRecorder?
+    /// Attributes the cost of the tracker calls to event names, when profiling is enabled.
+    private let profiler: EventCostProfiler?
+    /// :nodoc:
+    private let sampler = EventSampler()
+    /// :nodoc:
+    private let sampleRates: SampleRates
     /// :nodoc:
-    private var notificationsEnabled = false
-    private var postNotificationsEnabled: Bool = false
+    private let isSampling: Bool
+    /// :nodoc:
+    private let deduplicator: EventDeduplicator?
+    /// :nodoc:
+    private let rateLimiter: EventRateLimiter?
+    /// :nodoc:
+    private let router: EventRouter
+    /// :nodoc:
+    private let notificationsEnabled: Bool
+    private let postNotificationsEnabled: Bool
     private let options: UNAuthorizationOptions = [.alert]
     /// :nodoc:
     private let trackingOptOut = "tracking_opt_out"
@@ -80,7 +106,7 @@ open class StanwoodAnalytics {
     /**
      The event types used for tracking.
      */
-    public enum TrackingEvent: String {
+    public enum TrackingEvent: String, CaseIterable {
 
         case viewItem = "view_item"
         case purchase = "ecommerce_purchase"
@@ -92,6 +118,8 @@ open class StanwoodAnalytics {
         case message
         case debug
         case identifyUser = "identify_user"
+        case rateLimited = "rate_limited"
+        case circuitBreaker = "circuit_breaker"
     }
 
     /**
@@ -103,15 +131,103 @@ open class StanwoodAnalytics {
      */
     public init(builder: Builder) {
         trackers = builder.trackers
-
+        let tracer = builder.tracingEnabled ? TraceRecorder() : nil
+        self.tracer = tracer
+        let profiler = builder.profilingTopEvents.map { EventCostProfiler(topEvents: $0) }
+        self.profiler = profiler
+        channels = trackers.map { TrackerChannel(tracker: $0, tracer: tracer, profiler: profiler) }
+        dispatchTable = (0...Tracker.Capabilities.all.rawValue).map { rawValue in
+            channels.filter { !$0.capabilities.isDisjoint(with: Tracker.Capabilities(rawValue: rawValue)) }
+        }
+        sampleRates = builder.sampleRates
+        isSampling = builder.sampleRates.isSampling || trackers.contains { $0.sampleRates.isSampling }
+        deduplicator = builder.deduplicationWindow > 0 ? EventDeduplicator(window: builder.deduplicationWindow) : nil
+        rateLimiter = builder.rateLimit.map {
+            EventRateLimiter(eventsPerSecond: $0.eventsPerSecond, burst: $0.burst, sessionCap: $0.sessionCap)
+        }
+        router = EventRouter(trackerNames: StanwoodAnalytics.identifiers(of: trackers))
+        journal = builder.journalEnabled ? StanwoodAnalytics.openJournal(for: channels) : nil
         notificationsEnabled = builder.notificationsEnabled
         postNotificationsEnabled = builder.postNotificationsEnabled
 
+        for channel in channels {
+            channel.onBreakerChange = { [weak self] trackerName, state in
+                self?.reportBreaker(state, of: trackerName)
+            }
+        }
+
+        if let routingRules = builder.routingRules {
+            router.load(routingRules)
+        }
+
         if notificationsEnabled == true {
             addNotifications(with: builder.notificationDelegate!)
         }
 
         trackingEnable = DataStore.trackingEnabled
+
+        replayJournal()
+    }
+
+    /// The current value of trackingEnable.
+    private var isTrackingEnabled: Bool {
+        stateLock.lock()
+        defer { stateLock.unlock() }
+        return trackingEnable
+    }
+
+    /// Opens the journal, and moves the cursor of each tracker as its channel delivers the events.
+    private static func openJournal(for channels: [TrackerChannel]) -> EventJournal? {
+        guard let directory = EventJournal.defaultDirectory, let journal = EventJournal(directory: directory) else { return nil }
+
+        for (index, channel) in channels.enumerated() {
+            channel.onDelivered = { position in
+                journal.acknowledge(consumer: index, position: position)
+            }
+        }
+        return journal
+    }
+
+    /// A unique identifier for each tracker, used for its cursor in the journal.
+    private static func identifiers(of trackers: [Tracker]) -> [String] {
+        var counts: [String: Int] = [:]
+        return trackers.map { tracker in
+            let name = String(describing: type(of: tracker))
+            let count = counts[name, default: 0] + 1
+            counts[name] = count
+            return count == 1 ? name : "\(name)#\(count)"
+        }
+    }
+
+    /// Enqueues the events that were accepted in a previous session but not delivered. Each tracker continues from
+    /// its own cursor, so it only receives the events it has not had yet. They are discarded if tracking is disabled.
+    private func replayJournal() {
+        guard let journal = journal else { return }
+
+        let cursors = journal.register(consumers: StanwoodAnalytics.identifiers(of: trackers))
+        guard let start = cursors.min() else { return }
+
+        // The records are decoded in place, then enqueued once the journal is no longer being read.
+        var records: [(position: UInt64, endPosition: UInt64, operation: TrackerOperation?)] = []
+        let isEnabled = isTrackingEnabled
+        journal.forEachRecord(from: start) { record in
+            let operation = isEnabled == true ? TrackerOperation(journalPayload: record.payload) : nil
+            records.append((record.position, record.endPosition, operation))
+        }
+
+        for record in records {
+            let bucket = record.operation.flatMap { sampleBucket(for: $0) }
+            let routes = record.operation.map { self.routes(for: $0) } ?? EventRouter.all
+
+            for (index, channel) in channels.enumerated() where record.position >= cursors[index] {
+                if let operation = record.operation, !channel.capabilities.isDisjoint(with: operation.requiredCapabilities),
+                    StanwoodAnalytics.isRouted(routes, to: index) {
+                    send(operation, to: channel, bucket: bucket, journalPosition: record.endPosition)
+                } else {
+                    journal.acknowledge(consumer: index, position: record.endPosition)
+                }
+            }
+        }
     }
 
     /// :nodoc:
@@ -135,18 +251,202 @@ open class StanwoodAnalytics {
     }
 
     fileprivate func postNotification(payload: [String:String]) {
+        let start = tracer != nil ? DispatchTime.now().uptimeNanoseconds : 0
         let notificationCentre = NotificationCenter.default
         let notification = Notification.init(name: Notification.Name(rawValue: Keys.notificationName), object: nil, userInfo: payload)
         notificationCentre.post(notification)
+        tracer?.record(.notification, name: "postNotification", start: start)
+    }
+
+    /// Posts a change of the circuit breaker of a tracker to the debugger. The event name is circuit_breaker, the item
+    /// id the name of the tracker, and the category the new state: open, half_open or closed.
+    private func reportBreaker(_ state: CircuitBreaker.State, of trackerName: String) {
+        if state == .open {
+            print("StanwoodAnalytics Warning: \(trackerName) is over its budget, its operations are shed.")
+        }
+
+        postNotification(payload: [Keys.eventName: TrackingEvent.circuitBreaker.rawValue,
+                                   Keys.itemId: trackerName,
+                                   Keys.category: state.rawValue,
+                                   Keys.createdAt: PayloadTimestamp.now()])
     }
 
     // NODOC
     private func start() {
-        trackers.forEach {
-            $0.start()
+        enqueue(.start)
+    }
+
+    /// Enqueues the operation for the trackers, and records the span when tracing.
+    private func enqueue(_ operation: TrackerOperation) {
+        guard let tracer = tracer else {
+            dispatch(operation)
+            return
+        }
+
+        let start = DispatchTime.now().uptimeNanoseconds
+        dispatch(operation)
+        tracer.record(.enqueue, name: "enqueue \(operation.eventName ?? String(describing: operation.call))", start: start)
+    }
+
+    /// :nodoc:
+    private func dispatch(_ operation: TrackerOperation) {
+        let required = operation.requiredCapabilities
+        let targets = dispatchTable[required.rawValue]
+        guard !targets.isEmpty else {
+            // No tracker handles the operation.
+            return
+        }
+
+        let bucket = sampleBucket(for: operation)
+        if let bucket = bucket, let eventName = operation.eventName, bucket >= sampleRates.rate(for: eventName) {
+            // Sampled out for all the trackers.
+            return
+        }
+
+        let routes = self.routes(for: operation)
+        var journalPosition: UInt64?
+        if let journal = journal, let payload = operation.journalPayload {
+            journalPosition = journal.append(payload)
+        } else if routes == EventRouter.all {
+            targets.forEach { send(operation, to: $0, bucket: bucket, journalPosition: nil) }
+            return
+        }
+
+        // Every tracker has a cursor in the journal, so the trackers that do not receive the operation skip it.
+        for (index, channel) in channels.enumerated() {
+            if channel.capabilities.isDisjoint(with: required) || !StanwoodAnalytics.isRouted(routes, to: index) {
+                channel.skip(journalPosition: journalPosition)
+            } else {
+                send(operation, to: channel, bucket: bucket, journalPosition: journalPosition)
+            }
+        }
+    }
+
+    /// The trackers that receive an operation according to the routing rules. Only events are routed.
+    private func routes(for operation: TrackerOperation) -> UInt64 {
+        guard case .parameters(let event) = operation else { return EventRouter.all }
+        return router.routes(for: event.parameters)
+    }
+
+    /// :nodoc:
+    private static func isRouted(_ routes: UInt64, to index: Int) -> Bool {
+        return index >= 64 || routes & (1 << UInt64(index)) != 0
+    }
+
+    /// The sampling bucket of the current user for an event, or nil when the operation is not sampled.
+    private func sampleBucket(for operation: TrackerOperation) -> Double? {
+        guard isSampling, let eventName = operation.eventName else { return nil }
+        return sampler.bucket(for: eventName)
+    }
+
+    /// Enqueues the operation, unless the event is sampled out for the tracker.
+    private func send(_ operation: TrackerOperation, to channel: TrackerChannel, bucket: Double?, journalPosition: UInt64?) {
+        if let bucket = bucket, let eventName = operation.eventName, bucket >= channel.tracker.sampleRates.rate(for: eventName) {
+            channel.skip(journalPosition: journalPosition)
+        } else {
+            channel.enqueue(operation, journalPosition: journalPosition)
         }
     }
 
+    /// Blocks until every tracker has received the events tracked so far.
+    ///
+    /// Tracking calls return immediately and the trackers receive the events on their own serial queues.
+    /// Call this before the app is suspended, or in tests, to wait for the delivery.
+    open func flush() {
+        if isTrackingEnabled == true {
+            rateLimiter?.pendingSummaries().forEach { enqueue(.parameters(PreparedEvent($0, tracer: tracer))) }
+        }
+        channels.forEach { $0.flush() }
+        journal?.sync()
+    }
+
+    /// The counters of the buffer in front of each tracker, in the order the trackers were added.
+    ///
+    /// - Returns: An array of BufferStatistics.
+    public func bufferStatistics() -> [BufferStatistics] {
+        return channels.map { $0.statistics }
+    }
+
+    /// The latency of the calls on each tracker, in the order the trackers were added. Only the calls made at least
+    /// once since the last reset are included.
+    ///
+    /// The calls are timed on the tracker queues, so the latency is the time spent in the vendor framework and the
+    /// adapter, not the time an event waited in the buffer. Sample the statistics periodically with reset set to true
+    /// to get the latency of each period.
+    ///
+    /// - Parameter reset: Starts new histograms after reading them.
+    /// - Returns: An array of LatencyStatistics, one for each tracker and call.
+    public func latencyStatistics(reset: Bool = false) -> [LatencyStatistics] {
+        return channels.flatMap { $0.latency.statistics(reset: reset) }
+    }
+
+    /// Writes the spans recorded since the last call to a file in the Chrome trace event format, and removes them.
+    /// Open the file in chrome://tracing or Perfetto to see where the time goes in the pipeline.
+    ///
+    /// Tracing is enabled with setTracing(enabled:) in the builder. Call flush() first to include the tracker calls
+    /// of the events tracked so far.
+    ///
+    /// - Parameter url: The file URL. By default the file is written to Caches/StanwoodAnalytics/Traces.
+    /// - Returns: The URL of the file, or nil when tracing is not enabled or the file cannot be written.
+    @discardableResult
+    public func writeTrace(to url: URL? = nil) -> URL? {
+        guard let tracer = tracer else {
+            print("StanwoodAnalytics Warning: Tracing is not enabled in the builder.")
+            return nil
+        }
+
+        let fileName = "trace-\(Int(Date().timeIntervalSince1970)).json"
+        guard let url = url ?? TraceRecorder.defaultDirectory?.appendingPathComponent(fileName) else { return nil }
+        return tracer.write(to: url) ? url : nil
+    }
+
+    /// The event names that cost the most, by the CPU time of the tracker calls that delivered them. Use it to find the
+    /// tracking calls worth sampling, batching or removing.
+    ///
+    /// Profiling is enabled with setProfiling(enabled:topEvents:) in the builder. The costs are summed over all the
+    /// trackers since the analytics were built. They are estimates that are never lower than the true values.
+    ///
+    /// - Parameter limit: The maximum number of event names.
+    /// - Returns: An array of EventCost, the costliest first. Empty when profiling is not enabled.
+    public func eventCosts(limit: Int = 10) -> [EventCost] {
+        return profiler?.report(limit: limit) ?? []
+    }
+
+    /// The number of events dropped because an identical event was tracked within the deduplication window.
+    ///
+    /// - Returns: The number of duplicates. Always 0 when deduplication is not enabled in the builder.
+    public func duplicateCount() -> Int {
+        return deduplicator?.duplicateCount ?? 0
+    }
+
+    /// Replace the routing rules. The rules are compiled first and then swapped in, so tracking calls are not held up.
+    /// The current rules stay in place if the JSON is invalid. See Builder.setRouting(rules:) for the format.
+    ///
+    /// - Parameter rules: The JSON rule file.
+    /// - Returns: True if the rules were loaded.
+    @discardableResult
+    public func setRouting(rules: Data) -> Bool {
+        return router.load(rules)
+    }
+
+    /// Replace the routing rules with a bundled or downloaded JSON file.
+    ///
+    /// - Parameter url: The file URL of the rules.
+    /// - Returns: True if the rules were loaded.
+    @discardableResult
+    public func setRouting(contentsOf url: URL) -> Bool {
+        guard let rules = try? Data(contentsOf: url) else {
+            print("StanwoodAnalytics Error: The routing rules cannot be found at \(url).")
+            return false
+        }
+        return setRouting(rules: rules)
+    }
+
+    /// Remove the routing rules. Every event goes to every tracker.
+    public func removeRouting() {
+        router.reset()
+    }
+
     /**
 
      The Builder for this class.
@@ -156,23 +456,47 @@ open class StanwoodAnalytics {
         return Builder()
     }
 
-    /// Track data using TrackingParameters struct. It iterates over all the trackers and calls track on each.
+    /// Track data using TrackingParameters struct. The event is enqueued for each tracker and the call returns immediately.
     ///
     /// The parameters that are tracked depends on how each tracker is configured.
     ///
     /// - Parameter trackingParameters: TrackingParameters struct
     open func track(trackingParameters: TrackingParameters) {
-        if trackingEnable == true {
-            trackers.forEach { $0.track(trackingParameters: trackingParameters) }
+        if isTrackingEnabled == true {
+            guard deduplicator?.isDuplicate(trackingParameters.fingerprint) != true else { return }
 
-            showNotification(with: trackingParameters.debugInfo())
+            if let rateLimiter = rateLimiter {
+                let (allowed, summary) = rateLimiter.check(trackingParameters.eventName)
+                if let summary = summary {
+                    enqueue(.parameters(PreparedEvent(summary, tracer: tracer)))
+                }
+                guard allowed else { return }
+            }
+
+            let event = PreparedEvent(trackingParameters, tracer: tracer)
+            profiler?.recordEvent(trackingParameters.eventName)
+            enqueue(.parameters(event))
+
+            if notificationsEnabled == true {
+                showNotification(with: event.debugInfo)
+            }
 
             if postNotificationsEnabled == true {
-                postNotification(payload: trackingParameters.payload())
+                postNotification(payload: event.payload)
             }
         }
     }
 
+    /// Track a typed event. The event writes its fields with an EventEncoder, which is specialised for
+    /// each event type, so the values are not boxed as Any.
+    ///
+    /// - Parameter event: The event.
+    open func track<Event: TrackableEvent>(event: Event) {
+        var encoder = EventEncoder(eventName: Event.eventName)
+        event.encode(to: &encoder)
+        track(trackingParameters: encoder.parameters)
+    }
+
     /// :nodoc:
     fileprivate func showNotification(with message: String) {
         if notificationsEnabled == true {
@@ -193,6 +517,17 @@ open class StanwoodAnalytics {
         }
     }
 
+    /// The time spent setting up the analytics: each build() of a tracker builder, which runs the init of the tracker
+    /// and of its framework, each start() of a tracker and each build() of the analytics builder.
+    ///
+    /// The steps are measured in every process, so the report can be read or shipped at any time after the launch.
+    /// Print it to see a table of the steps.
+    ///
+    /// - Returns: The launch report.
+    public static func launchReport() -> LaunchReport {
+        return LaunchRecorder.report()
+    }
+
     /// Tracking Enabled. This is the value used for the next application start.
     ///
     /// - Returns: Bool value that is stored in UserDefaults.
@@ -236,22 +571,24 @@ open class StanwoodAnalytics {
             showAlert(on: viewController)
         }
 
-        if trackingEnable == true {
+        consentLock.lock()
+        if isTrackingEnabled == true {
             if enabled == false {
                 // turn off tracking
-                trackers.forEach {
-                    $0.setTracking(enabled: enabled)
-                }
+                enqueue(.setTracking(enabled))
 
                 trackSwitch(enabled: enabled)
             }
         } else {
-            // Tracked at startup was off.
+            // Tracked at startup was off. The trackers are started before any event is let through.
             start()
+            stateLock.lock()
             trackingEnable = true
+            stateLock.unlock()
         }
 
         DataStore.setTracking(enabled: enabled)
+        consentLock.unlock()
 
         if enabled == true {
             trackSwitch(enabled: enabled)
@@ -260,7 +597,11 @@ open class StanwoodAnalytics {
 
     /// :nodoc:
     private func showAlert(on viewController: UIViewController? = nil) {
-        
+        guard Thread.isMainThread else {
+            DispatchQueue.main.async { self.showAlert(on: viewController) }
+            return
+        }
+
         guard var rootViewController = viewController ?? UIApplication.shared.keyWindow?.rootViewController else { return }
         
         if let rootNav = rootViewController as? UINavigationController {
@@ -286,10 +627,18 @@ open class StanwoodAnalytics {
     ///
     /// - Parameter trackerKeys: TrackerKeys struct
     open func track(trackerKeys: TrackerKeys) {
-        if trackingEnable == true {
-            trackers.forEach { $0.track(trackerKeys: trackerKeys) }
+        if isTrackingEnabled == true {
+            guard deduplicator?.isDuplicate(trackerKeys.fingerprint) != true else { return }
 
-            showNotification(with: serializeKeys(trackerKeys: trackerKeys))
+            if let identifier = trackerKeys.values[Keys.identifier]?.string {
+                sampler.set(identifier: identifier)
+            }
+
+            enqueue(.keys(trackerKeys))
+
+            if notificationsEnabled == true {
+                showNotification(with: serializeKeys(trackerKeys: trackerKeys))
+            }
             
             if postNotificationsEnabled == true {
                 postNotification(payload: trackerKeys.payload())
@@ -300,8 +649,8 @@ open class StanwoodAnalytics {
     /// :nodoc:
     fileprivate func serializeKeys(trackerKeys: TrackerKeys) -> String {
         var message = ""
-        for (key, value) in trackerKeys.customKeys {
-            message.append(key + " " + String(describing: value))
+        for (key, value) in trackerKeys.values {
+            message.append(key + " " + value.stringValue)
         }
         return message
     }
@@ -310,8 +659,8 @@ open class StanwoodAnalytics {
     ///
     /// - Parameter error: NSError
     open func track(error: NSError) {
-        if trackingEnable == true {
-            trackers.forEach { $0.track(error: error) }
+        if isTrackingEnabled == true {
+            enqueue(.error(error))
         }
     }
 
@@ -322,9 +671,9 @@ open class StanwoodAnalytics {
     ///   - className: String
     open func trackScreen(name: String, className: String? = nil) {
         var trackerKeys = TrackerKeys()
-        trackerKeys.customKeys = [StanwoodAnalytics.Keys.screenName: name]
+        trackerKeys.set(name, forKey: StanwoodAnalytics.Keys.screenName)
         if let className = className {
-            trackerKeys.customKeys[StanwoodAnalytics.Keys.screenClass] = className
+            trackerKeys.set(className, forKey: StanwoodAnalytics.Keys.screenClass)
         }
         track(trackerKeys: trackerKeys)
     }
@@ -335,6 +684,13 @@ open class StanwoodAnalytics {
         var notificationsEnabled = false
         var notificationDelegate: UIViewController?
         var postNotificationsEnabled: Bool = false
+        var journalEnabled = false
+        var sampleRates = SampleRates()
+        var deduplicationWindow: TimeInterval = 0
+        var rateLimit: (eventsPerSecond: Double, burst: Int, sessionCap: Int)?
+        var routingRules: Data?
+        var tracingEnabled = false
+        var profilingTopEvents: Int?
 
         public func add(tracker: Tracker) -> Builder {
             trackers.append(tracker)
@@ -355,8 +711,110 @@ open class StanwoodAnalytics {
             return self
         }
 
+        /**
+         Persist the tracked events in a journal until every tracker has received them. Events that were not delivered
+         because the app was terminated are sent again on the next start. It is off by default.
+         */
+        public func setJournal(enabled: Bool) -> Builder {
+            journalEnabled = enabled
+            return self
+        }
+
+        /**
+         Send only a share of an event to all the trackers. The decision is made with a hash of the user identifier,
+         tracked with the key Keys.identifier, and the event name, so a user is either always or never sampled for an event.
+         Rates for single trackers are set in their builders.
+
+         - Parameters:
+           - rate: The share of events to keep, between 0 and 1.
+           - eventName: The event name.
+         */
+        public func setSampleRate(_ rate: Double, forEvent eventName: String) -> Builder {
+            sampleRates.set(rate, for: eventName)
+            return self
+        }
+
+        /**
+         Drop events and keys that are identical to one tracked within the window, for example a screen tracked
+         again each time viewDidAppear is called. It is off by default.
+
+         - Parameter window: The window in milliseconds. 0 disables deduplication.
+         */
+        public func setDeduplication(window: Int) -> Builder {
+            deduplicationWindow = TimeInterval(max(0, window)) / 1000
+            return self
+        }
+
+        /**
+         Limit how often each event name is tracked, to contain runaway tracking loops. Each event name has a token
+         bucket that refills at the rate. Events over the limit are suppressed and reported in a single rate_limited event
+         with the event name as the name, and the count in the custom parameter suppressed_count. It is off by default.
+
+         - Parameters:
+           - eventsPerSecond: The sustained rate allowed for each event name.
+           - burst: The number of events of a name allowed at once.
+           - sessionCap: The maximum number of events of a name in the session. 0 means no cap.
+         */
+        public func setRateLimit(eventsPerSecond: Double, burst: Int, sessionCap: Int = 0) -> Builder {
+            rateLimit = (eventsPerSecond, burst, sessionCap)
+            return self
+        }
+
+        /**
+         Route events to a subset of the trackers with rules in JSON. Trackers are named by class name, with or
+         without the Tracker suffix. The rules of the event "*" apply to every event, then the rules of the event.
+
+             { "rules": [ { "event": "ecommerce_purchase", "only": ["Firebase"] }, { "event": "debug", "drop": ["Mixpanel"] } ] }
+
+         The rules can be replaced at runtime with setRouting(rules:) on the analytics object.
+
+         - Parameter rules: The JSON rule file.
+         */
+        public func setRouting(rules: Data) -> Builder {
+            routingRules = rules
+            return self
+        }
+
+        /**
+         Route events with the rules in a bundled or downloaded JSON file. See setRouting(rules:).
+
+         - Parameter url: The file URL of the rules.
+         */
+        public func setRouting(contentsOf url: URL) -> Builder {
+            if let rules = try? Data(contentsOf: url) {
+                routingRules = rules
+            } else {
+                print("StanwoodAnalytics Error: The routing rules cannot be found at \(url).")
+            }
+            return self
+        }
+
+        /**
+         Record spans of the tracking pipeline: enqueuing in the track calls, mapping in the parameter mappers, the calls
+         on the trackers and the notifications posted to the debugger. Each thread records into its own buffer.
+         Write the trace with writeTrace(to:) on the analytics object. It is off by default.
+         */
+        public func setTracing(enabled: Bool) -> Builder {
+            tracingEnabled = enabled
+            return self
+        }
+
+        /**
+         Attribute the CPU time, heap growth and tracker calls of each event name, summed over all the trackers. The
+         costs are kept in fixed memory however many event names there are, and only the costliest names are listed.
+         Read them with eventCosts(limit:) on the analytics object. It is off by default.
+
+         - Parameters:
+           - enabled: Enables profiling.
+           - topEvents: The number of costliest event names that are kept.
+         */
+        public func setProfiling(enabled: Bool, topEvents: Int = 20) -> Builder {
+            profilingTopEvents = enabled ? topEvents : nil
+            return self
+        }
+
         public func build() -> StanwoodAnalytics {
-            return StanwoodAnalytics(builder: self)
+            return LaunchRecorder.measure(.analyticsBuild) { StanwoodAnalytics(builder: self) }
         }
     }
 }
@@ -0,0 +1,217 @@
+//
+//  Symbol.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// A small integer standing for an interned event name or key.
+///
+/// Symbols of the same string are equal, so trackers can compare event names and keys with an integer
+/// comparison instead of comparing or hashing strings. The symbol of the lowercased string is computed once
+/// when the string is interned, so case insensitive comparisons do not call lowercased() either.
+public struct Symbol: Hashable {
+    /// The index of the string in the symbol table.
+    public let rawValue: UInt32
+    /// The index of the lowercased string in the symbol table.
+    let foldedRawValue: UInt32
+
+    /// The symbol of the lowercased string.
+    public var folded: Symbol {
+        return Symbol(rawValue: foldedRawValue, foldedRawValue: foldedRawValue)
+    }
+
+    /// Interns a string. Returns nil if the table is full.
+    ///
+    /// - Parameter string: The event name or key.
+    public init?(_ string: String) {
+        guard let symbol = SymbolTable.shared.symbol(for: string) else { return nil }
+        self = symbol
+    }
+
+    /// :nodoc:
+    init(rawValue: UInt32, foldedRawValue: UInt32) {
+        self.rawValue = rawValue
+        self.foldedRawValue = foldedRawValue
+    }
+
+    /// Compares the lowercased strings.
+    ///
+    /// - Parameter other: The other symbol.
+    /// - Returns: True if the strings are equal ignoring case.
+    public func equalsIgnoringCase(_ other: Symbol) -> Bool {
+        return foldedRawValue == other.foldedRawValue
+    }
+
+    /// The interned string.
+    public var string: String {
+        return SymbolTable.shared.string(for: self)
+    }
+
+    public static func == (lhs: Symbol, rhs: Symbol) -> Bool {
+        return lhs.rawValue == rhs.rawValue
+    }
+
+    public func hash(into hasher: inout Hasher) {
+        hasher.combine(rawValue)
+    }
+}
+
+// MARK: Known symbols
+
+extension Symbol {
+
+    /// The event names of the framework, interned when the table is created so their symbols
+    /// do not depend on the room left in the table.
+    static var knownStrings: [String] {
+        return StanwoodAnalytics.TrackingEvent.allCases.map { $0.rawValue }
+    }
+}
+
+extension StanwoodAnalytics.TrackingEvent {
+
+    /// The symbols of all the events, so a new case cannot be left out.
+    private static let symbols: [StanwoodAnalytics.TrackingEvent: Symbol] = {
+        var symbols: [StanwoodAnalytics.TrackingEvent: Symbol] = [:]
+        for event in allCases {
+            symbols[event] = SymbolTable.shared.preinternedSymbol(for: event.rawValue)
+        }
+        return symbols
+    }()
+
+    /// The symbol of the event name.
+    public var symbol: Symbol {
+        return StanwoodAnalytics.TrackingEvent.symbols[self] ?? SymbolTable.shared.preinternedSymbol(for: rawValue)
+    }
+}
+
+/// The table of interned strings. It only grows, up to a fixed number of entries, so symbols stay valid for
+/// the lifetime of the app.
+final class SymbolTable {
+
+    /// The table used by the framework, with the known event names already interned.
+    static let shared = SymbolTable(preinterned: Symbol.knownStrings)
+
+    /// The maximum number of strings, including the lowercased forms.
+    static let capacity = 4096
+
+    private var indexes: [String: UInt32] = [:]
+    private var strings: [String] = []
+    private var foldedIndexes: [UInt32] = []
+    private let lock = NSLock()
+
+    /// Init with the strings to intern up front.
+    ///
+    /// - Parameter strings: The strings, interned before any other.
+    init(preinterned strings: [String] = []) {
+        for string in strings {
+            insert(string)
+        }
+    }
+
+    /// The symbol of a string, interning it if needed.
+    ///
+    /// - Parameter string: The string.
+    /// - Returns: The symbol, or nil if the string is new and the table is full.
+    func symbol(for string: String) -> Symbol? {
+        lock.lock()
+        defer { lock.unlock() }
+
+        if let index = indexes[string] {
+            return Symbol(rawValue: index, foldedRawValue: foldedIndexes[Int(index)])
+        }
+
+        let lowercased = string.lowercased()
+        let needed = lowercased == string || indexes[lowercased] != nil ? 1 : 2
+        guard strings.count + needed <= SymbolTable.capacity else { return nil }
+
+        return insert(string)
+    }
+
+    /// The symbol of a string interned when the table was created. It never fails: a string that was not
+    /// interned up front is added even if the table is full, so only call it for the known strings.
+    ///
+    /// - Parameter string: One of the strings the table was created with.
+    /// - Returns: The symbol.
+    func preinternedSymbol(for string: String) -> Symbol {
+        lock.lock()
+        defer { lock.unlock() }
+        return insert(string)
+    }
+
+    /// The string of a symbol.
+    func string(for symbol: Symbol) -> String {
+        lock.lock()
+        defer { lock.unlock() }
+        return strings[Int(symbol.rawValue)]
+    }
+
+    /// Adds a string and its lowercased form, without checking the capacity. Called with the lock held, or from init.
+    ///
+    /// - Parameter string: The string.
+    /// - Returns: The symbol of the string.
+    @discardableResult
+    private func insert(_ string: String) -> Symbol {
+        if let index = indexes[string] {
+            return Symbol(rawValue: index, foldedRawValue: foldedIndexes[Int(index)])
+        }
+
+        let lowercased = string.lowercased()
+        let folded = lowercased == string ? UInt32(strings.count) : intern(lowercased, folded: nil)
+        let index = intern(string, folded: folded)
+        return Symbol(rawValue: index, foldedRawValue: folded)
+    }
+
+    /// Adds a string. Called with the lock held, or from init.
+    ///
+    /// - Parameters:
+    ///   - string: The string.
+    ///   - folded: The index of the lowercased string, or nil if the string is lowercase already.
+    /// - Returns: The index of the string.
+    private func intern(_ string: String, folded: UInt32?) -> UInt32 {
+        if let index = indexes[string] {
+            return index
+        }
+        let index = UInt32(strings.count)
+        strings.append(string)
+        foldedIndexes.append(folded ?? index)
+        indexes[string] = index
+        return index
+    }
+}
+
+// MARK: Tracking parameters
+
+extension TrackingParameters {
+
+    /// Checks the event name ignoring case.
+    ///
+    /// - Parameter event: The event.
+    /// - Returns: True if the event name is the name of the event.
+    public func isEvent(_ event: StanwoodAnalytics.TrackingEvent) -> Bool {
+        if let eventSymbol = eventSymbol {
+            return eventSymbol.equalsIgnoringCase(event.symbol)
+        }
+        return eventName.lowercased() == event.rawValue
+    }
+}
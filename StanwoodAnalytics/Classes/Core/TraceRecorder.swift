@@ -0,0 +1,202 @@
+//
+//  TraceRecorder.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// The stages of the tracking pipeline that are traced.
+enum TraceStage: String {
+    /// StanwoodAnalytics enqueuing an operation for the trackers.
+    case enqueue
+    /// A parameter mapper mapping an event.
+    case mapping
+    /// A call on a tracker.
+    case tracker
+    /// The notification posted to the debugger.
+    case notification
+}
+
+/// A stage that ran on a thread, with its start and end uptime in nanoseconds.
+struct TraceSpan {
+    let stage: TraceStage
+    let name: String
+    let start: UInt64
+    let end: UInt64
+}
+
+/// The spans of one thread.
+///
+/// Only its thread appends to the buffer, so the lock is only contended while the trace is written. Spans over the
+/// capacity are counted and dropped.
+final class TraceBuffer {
+    let threadId: UInt32
+    let threadName: String
+    private weak var thread: Thread?
+    private let capacity: Int
+    private var spans: [TraceSpan] = []
+    private var dropped = 0
+    private let lock = NSLock()
+
+    /// Init for the current thread.
+    ///
+    /// - Parameter capacity: The maximum number of spans kept between two writes of the trace.
+    init(capacity: Int) {
+        threadId = pthread_mach_thread_np(pthread_self())
+        threadName = Thread.isMainThread ? "Main thread" : "Thread \(threadId)"
+        thread = Thread.current
+        self.capacity = capacity
+    }
+
+    /// False once the thread of the buffer exited, after which no span is appended.
+    var isThreadAlive: Bool {
+        return thread != nil
+    }
+
+    /// :nodoc:
+    func append(_ span: TraceSpan) {
+        lock.lock()
+        if spans.count < capacity {
+            spans.append(span)
+        } else {
+            dropped += 1
+        }
+        lock.unlock()
+    }
+
+    /// Removes and returns the spans recorded so far, and the number of spans dropped.
+    func removeSpans() -> (spans: [TraceSpan], dropped: Int) {
+        lock.lock()
+        defer { lock.unlock() }
+        let result = (spans, dropped)
+        spans = []
+        dropped = 0
+        return result
+    }
+}
+
+/// Records spans of the tracking pipeline and writes them in the Chrome trace event format, which can be opened in
+/// chrome://tracing or Perfetto.
+///
+/// Each thread records into its own buffer, found in the thread dictionary, so tracing threads do not wait for each
+/// other. The buffers are collected when the trace is written, and the buffers of threads that exited are dropped then.
+final class TraceRecorder {
+
+    /// The spans kept for each thread between two writes of the trace.
+    static let capacityPerThread = 100_000
+
+    /// The key of the buffer in the thread dictionary, unique to the recorder.
+    private let key: NSString = "io.stanwood.analytics.trace.\(UUID().uuidString)" as NSString
+    private var buffers: [TraceBuffer] = []
+    private let lock = NSLock()
+
+    /// The directory for traces written without a URL, in Caches.
+    static var defaultDirectory: URL? {
+        guard let directory = FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask).first else { return nil }
+        return directory.appendingPathComponent("StanwoodAnalytics", isDirectory: true).appendingPathComponent("Traces", isDirectory: true)
+    }
+
+    /// Records a span on the current thread.
+    ///
+    /// - Parameters:
+    ///   - stage: The stage of the pipeline.
+    ///   - name: The name displayed for the span.
+    ///   - start: The uptime in nanoseconds when the stage started.
+    ///   - end: The uptime in nanoseconds when the stage ended.
+    func record(_ stage: TraceStage, name: String, start: UInt64, end: UInt64 = DispatchTime.now().uptimeNanoseconds) {
+        currentBuffer().append(TraceSpan(stage: stage, name: name, start: start, end: end))
+    }
+
+    /// The buffer of the current thread, created with its first span.
+    private func currentBuffer() -> TraceBuffer {
+        let threadDictionary = Thread.current.threadDictionary
+        if let buffer = threadDictionary[key] as? TraceBuffer {
+            return buffer
+        }
+
+        let buffer = TraceBuffer(capacity: TraceRecorder.capacityPerThread)
+        threadDictionary[key] = buffer
+        lock.lock()
+        buffers.append(buffer)
+        lock.unlock()
+        return buffer
+    }
+
+    /// Writes the spans recorded since the last write to a file, and removes them.
+    ///
+    /// - Parameter url: The file URL.
+    /// - Returns: True if the file was written.
+    func write(to url: URL) -> Bool {
+        lock.lock()
+        let buffers = self.buffers
+        lock.unlock()
+
+        let processId = Int(ProcessInfo.processInfo.processIdentifier)
+        var events: [[String: Any]] = []
+        var dropped = 0
+        var exited: [TraceBuffer] = []
+
+        for buffer in buffers {
+            // Checked before the spans are removed, so a span appended before the thread exited is not lost.
+            if !buffer.isThreadAlive {
+                exited.append(buffer)
+            }
+            let (spans, droppedSpans) = buffer.removeSpans()
+            dropped += droppedSpans
+            guard !spans.isEmpty else { continue }
+
+            events.append(["name": "thread_name", "ph": "M", "pid": processId, "tid": Int(buffer.threadId),
+                           "args": ["name": buffer.threadName]])
+            for span in spans {
+                // Chrome trace times are in microseconds.
+                events.append(["name": span.name,
+                               "cat": span.stage.rawValue,
+                               "ph": "X",
+                               "ts": Double(span.start) / 1000,
+                               "dur": Double(span.end &- span.start) / 1000,
+                               "pid": processId,
+                               "tid": Int(buffer.threadId)])
+            }
+        }
+
+        if !exited.isEmpty {
+            lock.lock()
+            self.buffers.removeAll { buffer in exited.contains { $0 === buffer } }
+            lock.unlock()
+        }
+
+        if dropped > 0 {
+            print("StanwoodAnalytics Warning: \(dropped) spans were dropped from the trace, the thread buffers were full.")
+        }
+
+        do {
+            let data = try JSONSerialization.data(withJSONObject: ["traceEvents": events, "displayTimeUnit": "ns"], options: [])
+            try FileManager.default.createDirectory(at: url.deletingLastPathComponent(), withIntermediateDirectories: true, attributes: nil)
+            try data.write(to: url, options: .atomic)
+            return true
+        } catch {
+            print("StanwoodAnalytics Error: The trace cannot be written to \(url): \(error)")
+            return false
+        }
+    }
+}
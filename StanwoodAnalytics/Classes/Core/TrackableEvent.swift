@@ -0,0 +1,86 @@
+//
+//  TrackableEvent.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// An event type with a fixed name and typed fields.
+///
+/// Conforming types describe their fields once, in encode(to:), and are tracked with
+/// StanwoodAnalytics.track(event:). The encoder methods are generic over the value type, so the compiler
+/// specialises them for each event type and the values are never boxed as Any or cast back at runtime.
+///
+///     struct PurchaseEvent: TrackableEvent {
+///         static let eventName = StanwoodAnalytics.TrackingEvent.purchase.rawValue
+///
+///         let productId: String
+///         let price: Double
+///         let quantity: Int
+///
+///         func encode(to encoder: inout EventEncoder) {
+///             encoder.encode(productId, for: \.itemId)
+///             encoder.encode(price, forKey: "price")
+///             encoder.encode(quantity, forKey: "quantity")
+///         }
+///     }
+public protocol TrackableEvent {
+    /// The event name.
+    static var eventName: String { get }
+
+    /// Writes the fields of the event.
+    ///
+    /// - Parameter encoder: The encoder.
+    func encode(to encoder: inout EventEncoder)
+}
+
+/// Writes the fields of a TrackableEvent into tracking parameters.
+public struct EventEncoder {
+    /// The tracking parameters written so far.
+    private(set) var parameters: TrackingParameters
+
+    /// :nodoc:
+    init(eventName: String) {
+        parameters = TrackingParameters(eventName: eventName)
+    }
+
+    /// Writes one of the fields of TrackingParameters. Nil values are skipped.
+    ///
+    /// - Parameters:
+    ///   - value: The value.
+    ///   - field: The field, for example \.itemId or \.name.
+    public mutating func encode(_ value: String?, for field: WritableKeyPath<TrackingParameters, String?>) {
+        guard let value = value else { return }
+        parameters[keyPath: field] = value
+    }
+
+    /// Writes a custom parameter. Nil values are skipped.
+    ///
+    /// - Parameters:
+    ///   - value: A Bool, Int, Double, String, Date or TrackingValue.
+    ///   - key: The key.
+    public mutating func encode<Value: TrackingValueConvertible>(_ value: Value?, forKey key: String) {
+        guard let value = value else { return }
+        parameters.customValues[key] = value.trackingValue
+    }
+}
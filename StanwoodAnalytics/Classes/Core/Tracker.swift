@@ -37,6 +37,12 @@ open class Tracker {
     let context: UIApplication
     let logLevel: Int
     let isDebug: Bool
+    let bufferCapacity: Int
+    let overflowPolicy: OverflowPolicy
+    let batchSize: Int
+    let batchLatency: TimeInterval
+    let sampleRates: SampleRates
+    let budget: OverheadBudget?
     private let placeholderString = "your-key-here"
 
     /// Init method
@@ -49,6 +55,12 @@ open class Tracker {
         key = builder.key
         logLevel = builder.logLevel
         isDebug = builder.isDebug
+        bufferCapacity = builder.bufferCapacity
+        overflowPolicy = builder.overflowPolicy
+        batchSize = builder.batchSize
+        batchLatency = builder.batchLatency
+        sampleRates = builder.sampleRates
+        budget = builder.budget
     }
 
     final func checkKey() {
@@ -62,6 +74,18 @@ open class Tracker {
         assert(false)
     }
 
+    /// Calls start() and records its cost in the launch report. Call it instead of start() when the tracker starts in its init.
+    public final func startMeasured() {
+        let cpuStart = LaunchRecorder.threadCPUTime()
+        let startTime = DispatchTime.now().uptimeNanoseconds
+        start()
+        LaunchRecorder.record(.start,
+                              name: String(describing: type(of: self)),
+                              start: startTime,
+                              end: DispatchTime.now().uptimeNanoseconds,
+                              cpuTime: LaunchRecorder.threadCPUTime() &- cpuStart)
+    }
+
     /// Track data using tracking parameters. Called by StanwoodAnalytics class. This method must be overridden in a Tracker subclass.
     ///
     /// - Parameter trackingParameters: A struct for all the parameters
@@ -69,6 +93,28 @@ open class Tracker {
         assert(false)
     }
 
+    /// Track a prepared event. Called by StanwoodAnalytics class.
+    ///
+    /// The same prepared event is given to every tracker. The default implementation calls track(trackingParameters:).
+    /// Override it to use the forms of the event cached in the prepared event, so they are computed once for all the trackers.
+    ///
+    /// - Parameter event: The prepared event
+    open func track(event: PreparedEvent) {
+        track(trackingParameters: event.parameters)
+    }
+
+    /// Track a batch of events. Called by StanwoodAnalytics class when batching is enabled in the builder.
+    ///
+    /// The default implementation calls track(event:) for each event. Override it when the framework
+    /// can send several events with less work than sending them one by one.
+    ///
+    /// - Parameter batch: The events, in the order they were tracked.
+    open func track(batch: [PreparedEvent]) {
+        for event in batch {
+            track(event: event)
+        }
+    }
+
     /// Track using custom keys. Called by StanwoodAnalytics class. This method must be overridden in a Tracker subclass.
     ///
     /// - Parameter trackerKeys: A struct of custom keys.
@@ -90,9 +136,63 @@ open class Tracker {
         assert(false)
     }
 
+    /// The kinds of operations a tracker handles.
+    public struct Capabilities: OptionSet {
+        public let rawValue: Int
+
+        public init(rawValue: Int) {
+            self.rawValue = rawValue
+        }
+
+        /// track(trackingParameters:)
+        public static let events = Capabilities(rawValue: 1 << 0)
+        /// track(trackerKeys:) with keys other than the screen name and class.
+        public static let keys = Capabilities(rawValue: 1 << 1)
+        /// track(error:)
+        public static let errors = Capabilities(rawValue: 1 << 2)
+        /// track(trackerKeys:) with the screen name or class, as sent by trackScreen(name:className:).
+        public static let screenViews = Capabilities(rawValue: 1 << 3)
+        /// setTracking(enabled:)
+        public static let consent = Capabilities(rawValue: 1 << 4)
+
+        public static let all: Capabilities = [.events, .keys, .errors, .screenViews, .consent]
+    }
+
+    /// The operations the tracker handles. StanwoodAnalytics reads it once when it is built, and never prepares
+    /// or enqueues the other operations for the tracker. Override it when some of the track methods do nothing.
+    /// The default is all.
+    open var capabilities: Capabilities {
+        return .all
+    }
+
+    /// The calls that the framework requires on the main thread. StanwoodAnalytics reads it once when it is built,
+    /// and makes these calls on the main thread instead of the queue of the tracker, in the same order as the other calls.
+    /// Override it when the framework ignores or asserts on calls from other threads. The default is none.
+    open var mainThreadCalls: Set<TrackerCall> {
+        return []
+    }
+
+    /// What happens to an event when the buffer in front of the tracker is full.
+    ///
+    /// - dropOldest: Remove the oldest waiting event to make room. This is the default.
+    /// - dropNewest: Discard the new event.
+    /// - block: Wait up to the timeout (in seconds) for room, then discard the new event.
+    ///   Avoid long timeouts as tracking is usually called on the main thread.
+    public enum OverflowPolicy {
+        case dropOldest
+        case dropNewest
+        case block(timeout: TimeInterval)
+    }
+
     /// The builder for the tracker.
     open class Builder {
         var isDebug: Bool = BuildConfiguration.debug
+        var bufferCapacity = 256
+        var overflowPolicy: OverflowPolicy = .dropOldest
+        var batchSize = 1
+        var batchLatency: TimeInterval = 0
+        var sampleRates = SampleRates()
+        var budget: OverheadBudget?
         var logLevel = 0
         var loggingEnabled: Bool = false
         var exceptionTrackingEnabled = true
@@ -113,7 +213,15 @@ open class Tracker {
         ///
         /// - Returns: The configured Tracker object.
         open func build() -> Tracker {
-            return Tracker(builder: self)
+            return measured { Tracker(builder: self) }
+        }
+
+        /// Builds the tracker and records the cost of its init in the launch report. Call it in build().
+        ///
+        /// - Parameter make: Inits the tracker.
+        /// - Returns: The tracker.
+        public final func measured<T: Tracker>(_ make: () -> T) -> T {
+            return LaunchRecorder.measure(.trackerInit, make)
         }
 
         /// Enable the debug mode for the framework if aplicable. Returns the builder so that it can be chained.
@@ -142,5 +250,63 @@ open class Tracker {
             exceptionTrackingEnabled = enabled
             return self
         }
+
+        /// Set the size of the buffer in front of the tracker and what to do when it is full. Returns the builder so that it can be chained.
+        ///
+        /// - Parameters:
+        ///   - capacity: The maximum number of events waiting for the tracker. Must be greater than 0. The default is 256.
+        ///   - overflowPolicy: The policy applied when the buffer is full. The default is dropOldest.
+        /// - Returns: The builder object
+        open func setBuffer(capacity: Int, overflowPolicy: OverflowPolicy = .dropOldest) -> Builder {
+            bufferCapacity = max(1, capacity)
+            self.overflowPolicy = overflowPolicy
+            return self
+        }
+
+        /// Deliver events to the tracker in batches. Events are collected until the batch is full or the
+        /// latency has passed since the first event, whichever comes first. Returns the builder so that it can be chained.
+        ///
+        /// - Parameters:
+        ///   - size: The maximum number of events in a batch. The default of 1 disables batching.
+        ///   - latency: The maximum time in milliseconds an event waits for the batch to fill.
+        /// - Returns: The builder object
+        open func setBatching(size: Int, latency: Int) -> Builder {
+            batchSize = max(1, size)
+            batchLatency = TimeInterval(max(0, latency)) / 1000
+            return self
+        }
+
+        /// Send only a share of the events to this tracker. The decision is made per user and event name,
+        /// so a user is either always or never sampled for an event. Returns the builder so that it can be chained.
+        ///
+        /// - Parameters:
+        ///   - rate: The share of events to keep, between 0 and 1.
+        ///   - eventName: The event name, or nil to set the rate for all the events without a rate of their own.
+        /// - Returns: The builder object
+        open func setSampleRate(_ rate: Double, forEvent eventName: String? = nil) -> Builder {
+            sampleRates.set(rate, for: eventName)
+            return self
+        }
+
+        /// Set the overhead allowed for each call on the tracker. When the calls go over the budget several times in a row,
+        /// a circuit breaker opens and the operations for the tracker are shed. After the cooldown the next operation is a
+        /// probe: the breaker closes if the call is within the budget, and opens again if not. Start and setTracking are
+        /// always delivered. The changes of the breaker are posted with the notification Keys.notificationName.
+        /// With batching, the cost of a batch is divided by the number of its events before it is held to the budget.
+        /// Returns the builder so that it can be chained.
+        ///
+        /// - Parameters:
+        ///   - latency: The maximum duration of a call in milliseconds.
+        ///   - cpuTime: The maximum CPU time of a call in milliseconds, or nil for no limit.
+        ///   - failures: The number of consecutive calls over the budget that open the breaker. The default is 5.
+        ///   - cooldown: The time in milliseconds the breaker stays open before a probe. The default is 30 seconds.
+        /// - Returns: The builder object
+        open func setBudget(latency: Int, cpuTime: Int? = nil, failures: Int = 5, cooldown: Int = 30_000) -> Builder {
+            budget = OverheadBudget(latency: UInt64(max(0, latency)) * 1_000_000,
+                                    cpuTime: cpuTime.map { UInt64(max(0, $0)) * 1_000_000 },
+                                    failures: max(1, failures),
+                                    cooldown: UInt64(max(0, cooldown)) * 1_000_000)
+            return self
+        }
     }
 }
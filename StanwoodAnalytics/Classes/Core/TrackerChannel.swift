@@ -0,0 +1,587 @@
+//
+//  TrackerChannel.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// A unit of work that StanwoodAnalytics hands to a tracker.
+enum TrackerOperation {
+    case start
+    case parameters(PreparedEvent)
+    case keys(TrackerKeys)
+    case error(NSError)
+    case setTracking(Bool)
+
+    /// The event name of tracking parameters, nil for the other operations.
+    var eventName: String? {
+        if case .parameters(let event) = self {
+            return event.parameters.eventName
+        }
+        return nil
+    }
+
+    /// The capabilities a tracker needs for the operation. A tracker receives the operation if it has any of them.
+    var requiredCapabilities: Tracker.Capabilities {
+        switch self {
+        case .start:
+            return .all
+        case .parameters:
+            return .events
+        case .keys(let trackerKeys):
+            var capabilities: Tracker.Capabilities = []
+            for key in trackerKeys.values.keys {
+                if key == StanwoodAnalytics.Keys.screenName || key == StanwoodAnalytics.Keys.screenClass {
+                    capabilities.insert(.screenViews)
+                } else {
+                    capabilities.insert(.keys)
+                }
+            }
+            return capabilities
+        case .error:
+            return .errors
+        case .setTracking:
+            return .consent
+        }
+    }
+
+    /// Start and setTracking change the state of the framework and are never dropped by the overflow policy.
+    var isControl: Bool {
+        switch self {
+        case .start, .setTracking:
+            return true
+        case .parameters, .keys, .error:
+            return false
+        }
+    }
+
+    /// The call made on the tracker, for the latency statistics.
+    var call: TrackerCall {
+        switch self {
+        case .start:
+            return .start
+        case .parameters:
+            return .trackParameters
+        case .keys:
+            return .trackKeys
+        case .error:
+            return .trackError
+        case .setTracking:
+            return .setTracking
+        }
+    }
+
+    /// Calls the matching method on the tracker.
+    ///
+    /// - Parameter tracker: The tracker that receives the operation.
+    func apply(to tracker: Tracker) {
+        switch self {
+        case .start:
+            tracker.start()
+        case .parameters(let event):
+            tracker.track(event: event)
+        case .keys(let trackerKeys):
+            tracker.track(trackerKeys: trackerKeys)
+        case .error(let error):
+            tracker.track(error: error)
+        case .setTracking(let enabled):
+            tracker.setTracking(enabled: enabled)
+        }
+    }
+}
+
+/// Counters for the buffer in front of a tracker.
+public struct BufferStatistics {
+    /// The name of the tracker class.
+    public let trackerName: String
+    /// The capacity of the buffer.
+    public let capacity: Int
+    /// The number of operations accepted into the buffer.
+    public let enqueued: Int
+    /// The number of operations dropped by the overflow policy.
+    public let dropped: Int
+    /// The number of operations shed while the circuit breaker of the tracker was open.
+    public let shed: Int
+    /// The highest number of operations waiting in the buffer at the same time.
+    public let highWaterMark: Int
+}
+
+/// Pairs a tracker with its own serial queue and a bounded buffer.
+///
+/// StanwoodAnalytics only enqueues operations here and returns to the caller. The vendor SDK calls
+/// run on the queue of the tracker, in the order they were enqueued, so a slow framework does not
+/// block the UI or the other trackers. When the framework falls behind, the buffer fills up and the
+/// overflow policy of the tracker decides what happens to the next operation.
+///
+/// The calls the tracker requires on the main thread are handed to the main queue. The tracker queue waits until
+/// such a call has returned before it delivers the next operation, so the order is kept.
+///
+/// When batching is enabled for the tracker, consecutive events are coalesced and delivered with
+/// track(batch:) once the batch is full or the batch latency has passed.
+///
+/// Every call on the tracker is timed, and its duration recorded in the latency histogram of the call.
+/// When tracing is enabled, the call is also recorded as a span of the trace. When profiling is enabled, the CPU time
+/// and heap growth of the calls that deliver events are attributed to the event names.
+///
+/// When the tracker has an overhead budget, a circuit breaker sheds the operations for the tracker once its calls
+/// keep going over the budget. Start and setTracking are always delivered, and are not held to the budget.
+///
+/// Operations that were written to the event journal carry their journal position. The channel reports
+/// the position once the operation has been delivered or dropped, so the journal knows what is left to replay.
+final class TrackerChannel {
+
+    /// An operation waiting in the buffer. A nil operation only acknowledges its journal position, in order.
+    private struct Entry {
+        let operation: TrackerOperation?
+        let journalPosition: UInt64?
+
+        /// The entry, also acknowledging the position of a dropped entry that came before it.
+        func acknowledging(_ position: UInt64) -> Entry {
+            return Entry(operation: operation, journalPosition: max(journalPosition ?? 0, position))
+        }
+    }
+
+    /// An operation or batch taken from the buffer, ready to be delivered to the tracker.
+    private struct Delivery {
+        let operation: TrackerOperation?
+        let batch: [PreparedEvent]?
+        let journalPosition: UInt64?
+    }
+
+    let tracker: Tracker
+    /// The capabilities of the tracker, read once.
+    let capabilities: Tracker.Capabilities
+    /// The calls the tracker requires on the main thread, read once.
+    let mainThreadCalls: Set<TrackerCall>
+    let queue: DispatchQueue
+    /// The durations of the calls on the tracker.
+    let latency: LatencyRecorder
+    /// :nodoc:
+    private let trackerName: String
+    /// :nodoc:
+    private let tracer: TraceRecorder?
+    /// :nodoc:
+    private let profiler: EventCostProfiler?
+    /// The calls measured for the profiler. Only used by the thread delivering to the tracker.
+    private var profiledCalls = 0
+    /// Stops the calls on the tracker when they go over its budget. Only used by the thread delivering to the tracker.
+    private let breaker: CircuitBreaker?
+    /// Called on the tracker queue, or the main thread for main thread calls, with the name of the tracker and the new
+    /// state, when the circuit breaker changes.
+    var onBreakerChange: ((String, CircuitBreaker.State) -> Void)?
+    /// Called on the tracker queue, the main thread for main thread calls, or the enqueuing thread for dropped operations,
+    /// with the journal position of each handled operation.
+    var onDelivered: ((UInt64) -> Void)?
+    private let overflowPolicy: Tracker.OverflowPolicy
+    private let batchSize: Int
+    private let batchLatency: TimeInterval
+    private let condition = NSCondition()
+    /// The number of entries the buffer holds before the overflow policy applies. Only control operations go past it.
+    private let capacity: Int
+    private var buffer: RingBuffer<Entry>
+    private var isDrainScheduled = false
+    /// The delivery handed to the main thread, until it starts.
+    private var mainThreadDelivery: Delivery?
+    /// True from the moment a delivery is handed to the main thread until it has returned. The queue waits for it.
+    private var isWaitingForMainThread = false
+    private var enqueued = 0
+    private var dropped = 0
+    private var shed = 0
+    private var highWaterMark = 0
+
+    /// Init with the tracker. The buffer capacity and overflow policy are read from the tracker.
+    ///
+    /// - Parameters:
+    ///   - tracker: The tracker that receives the operations.
+    ///   - tracer: Records the calls on the tracker, when tracing is enabled.
+    ///   - profiler: Attributes the cost of the calls to event names, when profiling is enabled.
+    init(tracker: Tracker, tracer: TraceRecorder? = nil, profiler: EventCostProfiler? = nil) {
+        self.tracker = tracker
+        self.tracer = tracer
+        self.profiler = profiler
+        breaker = tracker.budget.map { CircuitBreaker(budget: $0) }
+        capabilities = tracker.capabilities
+        mainThreadCalls = tracker.mainThreadCalls
+        let name = String(describing: type(of: tracker))
+        trackerName = name
+        queue = DispatchQueue(label: "io.stanwood.analytics.\(name)", qos: .utility)
+        latency = LatencyRecorder(trackerName: name)
+        overflowPolicy = tracker.overflowPolicy
+        capacity = tracker.bufferCapacity
+        buffer = RingBuffer(capacity: tracker.bufferCapacity)
+        batchSize = tracker.batchSize
+        batchLatency = tracker.batchLatency
+    }
+
+    /// Enqueue an operation for the tracker. Returns immediately, unless the buffer is full and the policy is to block.
+    ///
+    /// - Parameters:
+    ///   - operation: The operation to run on the tracker queue.
+    ///   - journalPosition: The end position of the operation in the event journal, if it was journaled.
+    func enqueue(_ operation: TrackerOperation, journalPosition: UInt64? = nil) {
+        condition.lock()
+        defer { condition.unlock() }
+
+        var entry = Entry(operation: operation, journalPosition: journalPosition)
+
+        if buffer.count >= capacity && !makeRoom(for: &entry) {
+            discard(entry)
+            return
+        }
+
+        if buffer.isFull {
+            // The buffer only holds control operations, which are never dropped.
+            buffer.grow()
+        }
+        buffer.push(entry)
+        enqueued += 1
+        highWaterMark = max(highWaterMark, buffer.count)
+
+        if !isDrainScheduled {
+            isDrainScheduled = true
+            if batchSize > 1 && batchLatency > 0 {
+                queue.asyncAfter(deadline: .now() + batchLatency) { [weak self] in
+                    self?.drain()
+                }
+            } else {
+                scheduleDrain()
+            }
+        } else if batchSize > 1 && buffer.count == batchSize {
+            // A full batch does not wait for the latency to pass.
+            scheduleDrain()
+        }
+    }
+
+    /// :nodoc:
+    private func scheduleDrain() {
+        queue.async { [weak self] in
+            self?.drain()
+        }
+    }
+
+    /// Applies the overflow policy to a full buffer. Called with the lock held.
+    ///
+    /// A control operation always gets in: the oldest entry that is not a control operation is dropped, and when
+    /// there is none the buffer grows.
+    ///
+    /// - Parameter entry: The entry waiting to be enqueued. It acknowledges the journal position of an entry dropped
+    ///   from the end of the buffer.
+    /// - Returns: True if there is room for the entry.
+    private func makeRoom(for entry: inout Entry) -> Bool {
+        if entry.operation?.isControl == true {
+            dropOldest(before: &entry)
+            return true
+        }
+
+        switch overflowPolicy {
+        case .dropOldest:
+            return dropOldest(before: &entry)
+        case .dropNewest:
+            return false
+        case .block(let timeout):
+            let deadline = Date(timeIntervalSinceNow: timeout)
+            while buffer.count >= capacity {
+                if !condition.wait(until: deadline) {
+                    break
+                }
+            }
+            return buffer.count < capacity
+        }
+    }
+
+    /// Drops the oldest entry that is not a control operation. Called with the lock held.
+    ///
+    /// Its journal position is acknowledged by the entry that follows it, so the cursor of the journal does not move
+    /// past the entries before it, or the one being delivered.
+    ///
+    /// - Parameter entry: The entry waiting to be enqueued, which follows the last entry of the buffer.
+    /// - Returns: False if every entry is a control operation.
+    @discardableResult
+    private func dropOldest(before entry: inout Entry) -> Bool {
+        guard let offset = buffer.firstOffset(where: { $0.operation?.isControl != true }) else { return false }
+
+        let removed = buffer.remove(at: offset)
+        if removed.operation != nil {
+            dropped += 1
+        }
+        if let position = removed.journalPosition {
+            // The entries before the removed one have moved up by one, so the entry that followed it is at the same offset.
+            if offset < buffer.count {
+                buffer[offset] = buffer[offset].acknowledging(position)
+            } else {
+                entry = entry.acknowledging(position)
+            }
+        }
+        return true
+    }
+
+    /// Skips an operation that is not sent to this tracker, for example because it is sampled out.
+    ///
+    /// - Parameter journalPosition: The end position of the operation in the event journal, if it was journaled.
+    func skip(journalPosition: UInt64?) {
+        guard let position = journalPosition else { return }
+        condition.lock()
+        defer { condition.unlock() }
+
+        if buffer.isEmpty && !isDrainScheduled {
+            onDelivered?(position)
+        } else if buffer.count < capacity {
+            // Acknowledge it in order, after the operations already waiting.
+            buffer.push(Entry(operation: nil, journalPosition: position))
+        } else {
+            acknowledgeAfterBuffer(position)
+        }
+    }
+
+    /// Counts a dropped operation that was not enqueued. Called with the lock held.
+    private func discard(_ entry: Entry) {
+        if entry.operation != nil {
+            dropped += 1
+        }
+        if let position = entry.journalPosition {
+            acknowledgeAfterBuffer(position)
+        }
+    }
+
+    /// Acknowledges a journal position with the last entry of the full buffer, so it is acknowledged once the
+    /// entries before it have been delivered. Called with the lock held.
+    private func acknowledgeAfterBuffer(_ position: UInt64) {
+        guard !buffer.isEmpty else {
+            onDelivered?(position)
+            return
+        }
+        buffer[buffer.count - 1] = buffer[buffer.count - 1].acknowledging(position)
+    }
+
+    /// Delivers the buffered operations to the tracker. Runs on the tracker queue, or on the calling thread of flush().
+    private func drain() {
+        while true {
+            condition.lock()
+            if isWaitingForMainThread {
+                // A flush on the main thread delivers the waiting call itself, as the main queue is blocked until it returns.
+                // Otherwise the main thread schedules the next drain once the call has returned.
+                guard Thread.isMainThread, let delivery = mainThreadDelivery else {
+                    condition.unlock()
+                    return
+                }
+                mainThreadDelivery = nil
+                condition.unlock()
+                deliver(delivery)
+                endMainThreadDelivery()
+                continue
+            }
+
+            guard let entry = buffer.pop() else {
+                isDrainScheduled = false
+                condition.unlock()
+                return
+            }
+
+            let breakerState = breaker?.state
+            if let operation = entry.operation, !operation.isControl, breaker?.allowsCall() == false {
+                shed += 1
+                condition.broadcast()
+                condition.unlock()
+
+                if let position = entry.journalPosition {
+                    onDelivered?(position)
+                }
+                continue
+            }
+            reportBreaker(since: breakerState)
+
+            var journalPosition = entry.journalPosition
+            let batch = batchSize > 1 ? coalesce(after: entry, journalPosition: &journalPosition) : nil
+            let delivery = Delivery(operation: entry.operation, batch: batch, journalPosition: journalPosition)
+
+            let call = batch != nil ? .trackBatch : entry.operation?.call
+            if let call = call, mainThreadCalls.contains(call), !Thread.isMainThread {
+                mainThreadDelivery = delivery
+                isWaitingForMainThread = true
+                condition.broadcast()
+                condition.unlock()
+
+                DispatchQueue.main.async { [weak self] in
+                    self?.runMainThreadDelivery()
+                }
+                return
+            }
+
+            condition.broadcast()
+            condition.unlock()
+            deliver(delivery)
+        }
+    }
+
+    /// Makes the call on the tracker and acknowledges its journal position.
+    private func deliver(_ delivery: Delivery) {
+        if let batch = delivery.batch {
+            let usage = profiler != nil ? profiledUsage() : nil
+            let cpuStart = breakerCPUTime()
+            let start = DispatchTime.now().uptimeNanoseconds
+            tracker.track(batch: batch)
+            finish(.trackBatch, start: start, cpuStart: cpuStart, events: batch.count)
+            if let usage = usage {
+                profiler?.recordCall(batch.lazy.map { $0.parameters.eventName }, since: usage)
+            }
+        } else if let operation = delivery.operation {
+            let eventName = profiler != nil ? operation.eventName : nil
+            let usage = eventName != nil ? profiledUsage() : nil
+            let cpuStart = operation.call == .start ? LaunchRecorder.threadCPUTime() : operation.isControl ? nil : breakerCPUTime()
+            let start = DispatchTime.now().uptimeNanoseconds
+            operation.apply(to: tracker)
+            finish(operation.call, start: start, cpuStart: cpuStart)
+            if let eventName = eventName, let usage = usage {
+                profiler?.recordCall(CollectionOfOne(eventName), since: usage)
+            }
+        }
+
+        if let position = delivery.journalPosition {
+            onDelivered?(position)
+        }
+    }
+
+    /// The usage before a profiled call. The heap is only read before one call in `EventCostProfiler.heapSampleInterval`.
+    private func profiledUsage() -> ResourceUsage {
+        profiledCalls += 1
+        return ResourceUsage.current(readingHeap: profiledCalls % EventCostProfiler.heapSampleInterval == 0)
+    }
+
+    /// Delivers the call handed to the main thread, unless a flush on the main thread already has, and resumes the queue.
+    private func runMainThreadDelivery() {
+        condition.lock()
+        let delivery = mainThreadDelivery
+        mainThreadDelivery = nil
+        condition.unlock()
+
+        guard let waitingDelivery = delivery else { return }
+        deliver(waitingDelivery)
+        endMainThreadDelivery()
+        scheduleDrain()
+    }
+
+    /// :nodoc:
+    private func endMainThreadDelivery() {
+        condition.lock()
+        isWaitingForMainThread = false
+        condition.broadcast()
+        condition.unlock()
+    }
+
+    /// Records the duration of a call that has just returned, its span when tracing, and its cost in the circuit breaker.
+    /// The cost of start is recorded in the launch report. The budget is for each event, so the cost of a batch is
+    /// divided by its size before it is held to the budget.
+    ///
+    /// - Parameters:
+    ///   - call: The call.
+    ///   - start: The uptime in nanoseconds when the call was made.
+    ///   - cpuStart: The CPU time of the thread when the call was made, if the budget limits it or the call is start.
+    ///   - events: The number of events delivered by the call.
+    private func finish(_ call: TrackerCall, start: UInt64, cpuStart: UInt64?, events: Int = 1) {
+        let end = DispatchTime.now().uptimeNanoseconds
+        let cpuTime = cpuStart.map { LaunchRecorder.threadCPUTime() &- $0 }
+        latency.record(call, duration: end &- start)
+        tracer?.record(.tracker, name: "\(trackerName) \(call)", start: start, end: end)
+
+        if call == .start {
+            LaunchRecorder.record(.start, name: trackerName, start: start, end: end, cpuTime: cpuTime ?? 0)
+        }
+
+        if let breaker = breaker, call != .start, call != .setTracking {
+            let breakerState = breaker.state
+            let count = UInt64(max(1, events))
+            breaker.record(duration: (end &- start) / count, cpuTime: cpuTime.map { $0 / count }, now: end)
+            reportBreaker(since: breakerState)
+        }
+    }
+
+    /// The CPU time of the thread in nanoseconds, when the budget of the tracker limits it.
+    private func breakerCPUTime() -> UInt64? {
+        return breaker?.measuresCPUTime == true ? LaunchRecorder.threadCPUTime() : nil
+    }
+
+    /// Reports the state of the circuit breaker if it has changed.
+    ///
+    /// - Parameter previousState: The state before the last call or check.
+    private func reportBreaker(since previousState: CircuitBreaker.State?) {
+        if let breaker = breaker, let previousState = previousState, breaker.state != previousState {
+            onBreakerChange?(trackerName, breaker.state)
+        }
+    }
+
+    /// Collects the events that directly follow the entry into a batch. Called with the lock held.
+    ///
+    /// - Parameters:
+    ///   - entry: The entry removed from the buffer.
+    ///   - journalPosition: Updated to the journal position of the last event in the batch.
+    /// - Returns: The batch, or nil if the entry is not an event.
+    private func coalesce(after entry: Entry, journalPosition: inout UInt64?) -> [PreparedEvent]? {
+        guard case .parameters(let event)? = entry.operation else { return nil }
+
+        var batch: [PreparedEvent] = []
+        batch.reserveCapacity(batchSize)
+        batch.append(event)
+
+        while batch.count < batchSize, let next = buffer.first, case .parameters(let nextEvent)? = next.operation {
+            buffer.pop()
+            batch.append(nextEvent)
+            journalPosition = next.journalPosition ?? journalPosition
+        }
+        return batch
+    }
+
+    /// Blocks until all the operations enqueued so far have been delivered to the tracker,
+    /// including events waiting for a batch to fill.
+    func flush() {
+        repeat {
+            queue.sync {
+                drain()
+            }
+        } while !Thread.isMainThread && waitForMainThread()
+    }
+
+    /// Blocks until the call handed to the main thread has returned.
+    ///
+    /// - Returns: True if a call was waiting, and the buffer has to be drained again.
+    private func waitForMainThread() -> Bool {
+        condition.lock()
+        defer { condition.unlock() }
+        guard isWaitingForMainThread else { return false }
+        while isWaitingForMainThread {
+            condition.wait()
+        }
+        return true
+    }
+
+    /// The current counters of the buffer.
+    var statistics: BufferStatistics {
+        condition.lock()
+        defer { condition.unlock() }
+        return BufferStatistics(trackerName: String(describing: type(of: tracker)),
+                                capacity: capacity,
+                                enqueued: enqueued,
+                                dropped: dropped,
+                                shed: shed,
+                                highWaterMark: highWaterMark)
+    }
+}
@@ -27,13 +27,47 @@ import Foundation
 
 /// A Struct to contain custom keys.
 public struct TrackerKeys {
-    public var customKeys: [String: Any] = [:]
+    /// The typed custom keys.
+    public var values: [String: TrackingValue] = [:]
+
+    /// Custom keys as untyped values. Values other than Bool, Int, Double, String and Date are kept as
+    /// TrackingValue.other. Reading or writing the dictionary converts every value, so set a single key with
+    /// subscript(customKey:) or set(_:forKey:) instead.
+    public var customKeys: [String: Any] {
+        get {
+            return values.mapValues { $0.object }
+        }
+        set {
+            values = TrackingValue.values(of: newValue)
+        }
+    }
+
+    /// A custom key as an untyped value. Only the value of the key is converted.
+    ///
+    /// - Parameter key: The key.
+    public subscript(customKey key: String) -> Any? {
+        get {
+            return values[key]?.object
+        }
+        set {
+            values[key] = newValue.map { TrackingValue($0) }
+        }
+    }
 
     public init() {
     }
+
+    /// Set a custom key.
+    ///
+    /// - Parameters:
+    ///   - value: A Bool, Int, Double, String, Date or TrackingValue.
+    ///   - key: The key.
+    public mutating func set<Value: TrackingValueConvertible>(_ value: Value, forKey key: String) {
+        values[key] = value.trackingValue
+    }
     
     public func payload() -> [String:String] {
-        var payload: [String:String] = customKeys.mapValues({ "\($0)" })
+        var payload: [String:String] = values.mapValues { $0.stringValue }
         
         if payload[StanwoodAnalytics.Keys.eventName] == nil {
             if let _ = payload[StanwoodAnalytics.Keys.screenName] {
@@ -43,9 +77,7 @@ public struct TrackerKeys {
             }
         }
         
-        let dateFormatter = DateFormatter()
-        dateFormatter.dateFormat = "yyyy-MM-dd'T'HH:mm:ssZ"
-        payload[StanwoodAnalytics.Keys.createdAt] = dateFormatter.string(from: Date())
+        payload[StanwoodAnalytics.Keys.createdAt] = PayloadTimestamp.now()
         return payload
     }
 }
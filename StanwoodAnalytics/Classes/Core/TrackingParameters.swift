@@ -24,7 +24,39 @@ public struct TrackingParameters {
     /// Content Type
     public var contentType: String?
     /// Define custom parameters here
-    public var customParameters: [String: Any] = [:]
+    public var customValues: [String: TrackingValue] = [:]
+
+    /// Custom parameters as untyped values. Values other than Bool, Int, Double, String and Date are kept as
+    /// TrackingValue.other. Reading or writing the dictionary converts every value, so set a single parameter with
+    /// subscript(customParameter:) or customValues instead.
+    public var customParameters: [String: Any] {
+        get {
+            return customValues.mapValues { $0.object }
+        }
+        set {
+            customValues = TrackingValue.values(of: newValue)
+        }
+    }
+
+    /// A custom parameter as an untyped value. Only the value of the key is converted.
+    ///
+    /// - Parameter key: The key of the custom parameter.
+    public subscript(customParameter key: String) -> Any? {
+        get {
+            return customValues[key]?.object
+        }
+        set {
+            customValues[key] = newValue.map { TrackingValue($0) }
+        }
+    }
+
+    /// The interned event name, for fast comparisons. Nil if the symbol table is full.
+    ///
+    /// The name is interned when the symbol is first read, by the routing or a tracker comparing event names,
+    /// so tracking an event does not take the lock of the symbol table.
+    public var eventSymbol: Symbol? {
+        return Symbol(eventName)
+    }
 
     /// Init with event name only. The remaining parameters are all set to nil.
     ///
@@ -136,9 +168,22 @@ public struct TrackingParameters {
             payload[StanwoodAnalytics.Keys.contentType] = contentType
         }
         
+        payload[StanwoodAnalytics.Keys.createdAt] = PayloadTimestamp.now()
+        return payload
+    }
+}
+
+/// The creation date of the debugger payloads.
+enum PayloadTimestamp {
+    /// Creating a DateFormatter is expensive, and formatting is thread safe, so every payload shares one.
+    private static let formatter: DateFormatter = {
         let dateFormatter = DateFormatter()
         dateFormatter.dateFormat = "yyyy-MM-dd'T'HH:mm:ssZ"
-        payload[StanwoodAnalytics.Keys.createdAt] = dateFormatter.string(from: Date())
-        return payload
+        return dateFormatter
+    }()
+
+    /// The current date, formatted.
+    static func now() -> String {
+        return formatter.string(from: Date())
     }
 }
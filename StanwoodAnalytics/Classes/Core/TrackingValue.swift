@@ -0,0 +1,209 @@
+//
+//  TrackingValue.swift
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2018 Stanwood GmbH (www.stanwood.io)
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+import Foundation
+
+/// A typed value of a custom parameter or key.
+///
+/// Custom parameters and keys are stored as TrackingValue instead of Any, so the trackers and the journal
+/// switch over a few cases instead of casting the values at runtime.
+public enum TrackingValue: Equatable {
+    case bool(Bool)
+    case int(Int)
+    case double(Double)
+    case string(String)
+    case date(Date)
+    /// Any other value, such as an array, a dictionary or a URL. It is passed unchanged to the frameworks that take
+    /// any object, and as its description to the ones that take strings.
+    case other(Any)
+
+    /// Init from a value of unknown type.
+    ///
+    /// NSNumber values are converted to Bool, Int or Double depending on the number type. Values of other types
+    /// than Bool, Int, Double, String and Date are kept as they are.
+    ///
+    /// - Parameter value: The value.
+    public init(_ value: Any) {
+        switch value {
+        case let value as TrackingValue:
+            self = value
+        case let string as String:
+            self = .string(string)
+        case let number as NSNumber:
+            self = TrackingValue(number: number)
+        case let date as Date:
+            self = .date(date)
+        default:
+            self = .other(value)
+        }
+    }
+
+    /// :nodoc:
+    private init(number: NSNumber) {
+        if CFGetTypeID(number) == CFBooleanGetTypeID() {
+            self = .bool(number.boolValue)
+        } else if CFNumberIsFloatType(number) {
+            self = .double(number.doubleValue)
+        } else {
+            self = .int(number.intValue)
+        }
+    }
+
+    /// The value as a string, for logging and for frameworks that only take strings.
+    public var stringValue: String {
+        switch self {
+        case .bool(let value):
+            return String(value)
+        case .int(let value):
+            return String(value)
+        case .double(let value):
+            return String(value)
+        case .string(let value):
+            return value
+        case .date(let value):
+            return String(describing: value)
+        case .other(let value):
+            return String(describing: value)
+        }
+    }
+
+    /// The string, if the value is a string.
+    public var string: String? {
+        if case .string(let value) = self {
+            return value
+        }
+        return nil
+    }
+
+    /// The value as a Foundation object, for frameworks that take Any.
+    public var object: Any {
+        switch self {
+        case .bool(let value):
+            return value
+        case .int(let value):
+            return value
+        case .double(let value):
+            return value
+        case .string(let value):
+            return value
+        case .date(let value):
+            return value
+        case .other(let value):
+            return value
+        }
+    }
+
+    public static func == (lhs: TrackingValue, rhs: TrackingValue) -> Bool {
+        switch (lhs, rhs) {
+        case let (.bool(lhs), .bool(rhs)):
+            return lhs == rhs
+        case let (.int(lhs), .int(rhs)):
+            return lhs == rhs
+        case let (.double(lhs), .double(rhs)):
+            return lhs == rhs
+        case let (.string(lhs), .string(rhs)):
+            return lhs == rhs
+        case let (.date(lhs), .date(rhs)):
+            return lhs == rhs
+        case let (.other(lhs), .other(rhs)):
+            return (lhs as AnyObject).isEqual(rhs as AnyObject)
+        default:
+            return false
+        }
+    }
+}
+
+extension TrackingValue: ExpressibleByBooleanLiteral, ExpressibleByIntegerLiteral, ExpressibleByFloatLiteral, ExpressibleByStringLiteral {
+
+    public init(booleanLiteral value: Bool) {
+        self = .bool(value)
+    }
+
+    public init(integerLiteral value: Int) {
+        self = .int(value)
+    }
+
+    public init(floatLiteral value: Double) {
+        self = .double(value)
+    }
+
+    public init(stringLiteral value: String) {
+        self = .string(value)
+    }
+}
+
+/// A type that converts to a TrackingValue without boxing. Bool, Int, Double, String and Date conform.
+public protocol TrackingValueConvertible {
+    var trackingValue: TrackingValue { get }
+}
+
+extension Bool: TrackingValueConvertible {
+    public var trackingValue: TrackingValue {
+        return .bool(self)
+    }
+}
+
+extension Int: TrackingValueConvertible {
+    public var trackingValue: TrackingValue {
+        return .int(self)
+    }
+}
+
+extension Double: TrackingValueConvertible {
+    public var trackingValue: TrackingValue {
+        return .double(self)
+    }
+}
+
+extension String: TrackingValueConvertible {
+    public var trackingValue: TrackingValue {
+        return .string(self)
+    }
+}
+
+extension Date: TrackingValueConvertible {
+    public var trackingValue: TrackingValue {
+        return .date(self)
+    }
+}
+
+extension TrackingValue: TrackingValueConvertible {
+    public var trackingValue: TrackingValue {
+        return self
+    }
+}
+
+// MARK: Dictionaries
+
+extension TrackingValue {
+
+    /// Converts a dictionary of unknown values.
+    ///
+    /// - Parameter dictionary: The dictionary.
+    /// - Returns: The typed values.
+    static func values(of dictionary: [String: Any]) -> [String: TrackingValue] {
+        return dictionary.mapValues { TrackingValue($0) }
+    }
+}
@@ -27,34 +27,87 @@ import Foundation
 import FirebaseCore
 import FirebaseCrashlytics
 
+/// The functions of Crashlytics used by the tracker.
+///
+/// The tracker calls Crashlytics through this protocol, so that tests and benchmarks can measure the tracker with
+/// a stand-in instead of the SDK. Set one with CrashlyticsBuilder.set(crashlytics:).
+public protocol CrashlyticsEnabler {
+    func configure()
+    func log(_ message: String)
+    func record(error: NSError)
+    func setUserID(_ identifier: String)
+    func setCustomValue(_ value: Any, forKey key: String)
+}
+
+/// Forwards to Crashlytics.
+struct CrashlyticsSDK: CrashlyticsEnabler {
+
+    /// Configures Firebase, which starts Crashlytics.
+    func configure() {
+        if FirebaseApp.app() == nil {
+            FirebaseApp.configure()
+        }
+    }
+
+    func log(_ message: String) {
+        Crashlytics.crashlytics().log(message)
+    }
+
+    func record(error: NSError) {
+        Crashlytics.crashlytics().record(error: error)
+    }
+
+    func setUserID(_ identifier: String) {
+        Crashlytics.crashlytics().setUserID(identifier)
+    }
+
+    func setCustomValue(_ value: Any, forKey key: String) {
+        Crashlytics.crashlytics().setCustomValue(value, forKey: key)
+    }
+}
+
 /// Fabric Tracker
 ///
 /// For this tracker to work, it is necessary to insert the Fabric and Crashlytics configuration into the Info.plist,
 /// and add a run script phase that calls Fabric.framework/run with the token.
 open class CrashlyticsTracker: Tracker {
 
+    let crashlytics: CrashlyticsEnabler
+    /// :nodoc:
+    private let hasStandIn: Bool
+
     /// Init function
     ///
     /// - Parameter builder: Tracker builder
     init(builder: CrashlyticsBuilder) {
+        crashlytics = builder.crashlytics ?? CrashlyticsSDK()
+        hasStandIn = builder.crashlytics != nil
         super.init(builder: builder)
 
         if StanwoodAnalytics.trackingEnabled() == true {
-            start()
+            startMeasured()
         }
     }
 
     /// Start the tracking. This function verifies that the Fabric key has been defined in the Application Info.plist
     open override func start() {
-        if hasFabricKey() == true {
-            if FirebaseApp.app() == nil {
-                FirebaseApp.configure()
-            }
+        if hasStandIn || hasFabricKey() == true {
+            crashlytics.configure()
         } else {
             print("StanwoodAnalytics Error: The Fabric API key is not found in the Info.plist.")
         }
     }
 
+    /// setTracking is not implemented.
+    open override var capabilities: Capabilities {
+        return [.events, .keys, .screenViews, .errors]
+    }
+
+    /// Fabric is set up on the main thread, as in application(_:didFinishLaunchingWithOptions:).
+    open override var mainThreadCalls: Set<TrackerCall> {
+        return [.start]
+    }
+
     /// :nodoc:
     private func hasFabricKey() -> Bool {
         guard let path = Bundle.main.path(forResource: "Info", ofType: "plist") else { return false }
@@ -69,15 +122,17 @@ open class CrashlyticsTracker: Tracker {
     ///
     /// - Parameter trackingParameters: `TrackingParameters` struct
     open override func track(trackingParameters: TrackingParameters) {
+        track(event: PreparedEvent(trackingParameters))
+    }
 
-        let logMessage = "Event: \(String(describing: trackingParameters.eventName)) "
-            + "Name: \(String(describing: trackingParameters.name)) "
-            + "ItemId: \(String(describing: trackingParameters.itemId))"
-
+    /// Track a prepared event. The log message is shared with the other trackers.
+    ///
+    /// - Parameter event: Prepared event
+    open override func track(event: PreparedEvent) {
         #if DEBUG || STAGE
-            Crashlytics.crashlytics().log("\(logMessage)")
+            crashlytics.log(event.logMessage)
         #else
-            //CLSLogv("%s", getVaList([logMessage]))
+            //CLSLogv("%s", getVaList([event.logMessage]))
         #endif
     }
 
@@ -92,7 +147,7 @@ open class CrashlyticsTracker: Tracker {
     ///
     /// - Parameter error: NSError
     open override func track(error: NSError) {
-        Crashlytics.crashlytics().record(error: error)
+        crashlytics.record(error: error)
     }
 
     /**
@@ -113,28 +168,36 @@ open class CrashlyticsTracker: Tracker {
     ///
     /// - Parameter trackerKeys: trackerKeys
     open override func track(trackerKeys: TrackerKeys) {
-        let customKeys = trackerKeys.customKeys
-
-        for (key, value) in customKeys {
+        for (key, value) in trackerKeys.values {
             if key == StanwoodAnalytics.Keys.identifier {
-                if let identifier = value as? String {
-                    Crashlytics.crashlytics().setUserID(identifier)
+                if case .string(let identifier) = value {
+                    crashlytics.setUserID(identifier)
                 }
             } else {
-                Crashlytics.crashlytics().setCustomValue(value, forKey: key)
+                crashlytics.setCustomValue(value.object, forKey: key)
             }
         }
     }
 
     /// The builder class for this tracker. Although the application is a required parameter, it is not used.
     open class CrashlyticsBuilder: Tracker.Builder {
+        var crashlytics: CrashlyticsEnabler?
 
         public override init(context: UIApplication, key: String?) {
             super.init(context: context, key: key)
         }
 
+        /// Set a stand-in for Crashlytics. The Fabric key is not checked when it is set.
+        ///
+        /// - Parameter crashlytics: The stand-in
+        /// - Returns: Builder so that it can be chained.
+        open func set(crashlytics: CrashlyticsEnabler) -> CrashlyticsBuilder {
+            self.crashlytics = crashlytics
+            return self
+        }
+
         open override func build() -> CrashlyticsTracker {
-            return CrashlyticsTracker(builder: self)
+            return measured { CrashlyticsTracker(builder: self) }
         }
     }
 }
@@ -38,50 +38,58 @@ import FirebaseAnalytics
 
  */
 
-/// Custom parameter mapper for Firebase.
+/// Default parameter mapper for Firebase.
 ///
 /// ItemId -> AnalyticsParameterItemID
 /// ContentType -> AnalyticsParameterContentType
 /// Category -> AnalyticsParameterItemCategory
 /// Name -> AnalyticsParameterItemName
 ///
-struct FirebaseParameterMapper: ParameterMapper {
-    func map(parameters: TrackingParameters) -> [String: NSString] {
-        var keyValues: [String: NSString] = [:]
-
-        if let itemId = parameters.itemId {
-            keyValues[AnalyticsParameterItemID] = NSString(string: itemId)
-        }
-
-        if let contentType = parameters.contentType {
-            keyValues[AnalyticsParameterContentType] = NSString(string: contentType)
-        }
-
-        if let category = parameters.category {
-            keyValues[AnalyticsParameterItemCategory] = NSString(string: category)
-        }
-
-        if let name = parameters.name {
-            keyValues[AnalyticsParameterItemName] = NSString(string: name)
-        }
-
-        return keyValues
-    }
+enum FirebaseParameterMapper {
+    /// The compiled plan, shared by all the Firebase trackers.
+    static let plan = MappingPlan()
+        .map(.itemId, to: AnalyticsParameterItemID)
+        .map(.contentType, to: AnalyticsParameterContentType)
+        .map(.category, to: AnalyticsParameterItemCategory)
+        .map(.name, to: AnalyticsParameterItemName)
+        .compile()
 }
 
 public protocol FirebaseCoreEnabler {
     static func configure(options: [String: String])
 }
 
+/// The functions of FirebaseAnalytics used by the tracker.
+///
+/// The tracker calls Firebase through this protocol, so that tests and benchmarks can measure the tracker with
+/// a stand-in instead of the SDK. Set one with FirebaseBuilder.set(analytics:).
 public protocol FirebaseAnalyticsEnabler {
-    static func logEvent()
-    static func setScreenName()
+    func logEvent(_ name: String, parameters: [String: Any]?)
+    func setScreenName(_ screenName: String, screenClass: String?)
+    func setAnalyticsCollectionEnabled(_ enabled: Bool)
+}
+
+/// Forwards to FirebaseAnalytics.
+struct FirebaseAnalyticsSDK: FirebaseAnalyticsEnabler {
+
+    func logEvent(_ name: String, parameters: [String: Any]?) {
+        Analytics.logEvent(name, parameters: parameters)
+    }
+
+    func setScreenName(_ screenName: String, screenClass: String?) {
+        Analytics.setScreenName(screenName, screenClass: screenClass)
+    }
+
+    func setAnalyticsCollectionEnabled(_ enabled: Bool) {
+        Analytics.setAnalyticsCollectionEnabled(enabled)
+    }
 }
 
 /// FirebaseAnalytics Tracker
 open class FirebaseTracker: Tracker {
 
     var parameterMapper: ParameterMapper?
+    let analytics: FirebaseAnalyticsEnabler
 
     /// Init method for the tracker. It checks that tracking enabled is set in the StanwoodAnalytics framework.
     /// It will then check for the existence for FirebaseApp to see if an init call already been called
@@ -91,15 +99,23 @@ open class FirebaseTracker: Tracker {
     ///
     /// - Parameter builder: <#builder description#>
     init(builder: FirebaseBuilder) {
+        analytics = builder.analytics ?? FirebaseAnalyticsSDK()
         super.init(builder: builder)
 
-        if builder.parameterMapper == nil {
-            parameterMapper = FirebaseParameterMapper()
+        if let plan = builder.parameterMapper as? MappingPlan {
+            parameterMapper = plan.compile()
+        } else if builder.parameterMapper == nil {
+            parameterMapper = FirebaseParameterMapper.plan
         } else {
             parameterMapper = builder.parameterMapper
         }
 
-        Analytics.setAnalyticsCollectionEnabled(StanwoodAnalytics.trackingEnabled())
+        analytics.setAnalyticsCollectionEnabled(StanwoodAnalytics.trackingEnabled())
+
+        if builder.analytics != nil {
+            // A stand-in does not need Firebase.
+            return
+        }
 
         if FirebaseApp.app() == nil {
 
@@ -129,14 +145,24 @@ open class FirebaseTracker: Tracker {
         return true
     }
 
+    /// Only the screen name and class are tracked from the keys.
+    open override var capabilities: Capabilities {
+        return [.events, .screenViews, .errors, .consent]
+    }
+
+    /// Firebase ignores setScreenName when it is not called on the main thread.
+    open override var mainThreadCalls: Set<TrackerCall> {
+        return [.start, .trackKeys, .setTracking]
+    }
+
     /// Calls the enable function of the analytics collection function of the FirebaseAnalytics framework.
     open override func start() {
-        Analytics.setAnalyticsCollectionEnabled(true)
+        analytics.setAnalyticsCollectionEnabled(true)
     }
 
     /// Sets the analytics collection enabled or disabled.
     open override func setTracking(enabled: Bool) {
-        Analytics.setAnalyticsCollectionEnabled(enabled)
+        analytics.setAnalyticsCollectionEnabled(enabled)
     }
 
     /// Track data in the TrackingParameters struct into FirebaseAnalytics.
@@ -154,9 +180,17 @@ open class FirebaseTracker: Tracker {
     ///
     /// - Parameter trackingParameters: TrackingParameters struct
     open override func track(trackingParameters: TrackingParameters) {
+        track(event: PreparedEvent(trackingParameters))
+    }
+
+    /// Track a prepared event. The mapped parameters are shared with the other trackers using the same mapper.
+    ///
+    /// - Parameter event: Prepared event
+    open override func track(event: PreparedEvent) {
+        let trackingParameters = event.parameters
 
-        if parameterMapper != nil {
-            Analytics.logEvent(trackingParameters.eventName, parameters: parameterMapper?.map(parameters: trackingParameters))
+        if let parameterMapper = parameterMapper {
+            analytics.logEvent(trackingParameters.eventName, parameters: event.mapped(by: parameterMapper))
         } else {
             var keyValueDict: [String: NSString] = ["event_name": trackingParameters.eventName as NSString]
 
@@ -180,7 +214,7 @@ open class FirebaseTracker: Tracker {
                 keyValueDict["description"] = description as NSString
             }
 
-            Analytics.logEvent(trackingParameters.eventName, parameters: keyValueDict)
+            analytics.logEvent(trackingParameters.eventName, parameters: keyValueDict)
         }
     }
 
@@ -192,7 +226,7 @@ open class FirebaseTracker: Tracker {
 
     open override func track(error: NSError) {
         let parameters = error.userInfo as [String: Any]
-        Analytics.logEvent("error", parameters: parameters)
+        analytics.logEvent("error", parameters: parameters)
     }
 
     /**
@@ -203,27 +237,13 @@ open class FirebaseTracker: Tracker {
 
      */
     open override func track(trackerKeys: TrackerKeys) {
-        let customKeys = trackerKeys.customKeys
+        let values = trackerKeys.values
 
-        var screenName: String = ""
-        var screenClass: String = ""
-
-        for (key, value) in customKeys {
-            if key == StanwoodAnalytics.Keys.screenName {
-                screenName = value as! String
-            }
-
-            if key == StanwoodAnalytics.Keys.screenClass {
-                screenClass = value as! String
-            }
-        }
+        let screenName = values[StanwoodAnalytics.Keys.screenName]?.string ?? ""
+        let screenClass = values[StanwoodAnalytics.Keys.screenClass]?.string ?? ""
 
         if !screenName.isEmpty {
-            if screenClass.isEmpty {
-                Analytics.setScreenName(screenName, screenClass: nil)
-            } else {
-                Analytics.setScreenName(screenName, screenClass: screenClass)
-            }
+            analytics.setScreenName(screenName, screenClass: screenClass.isEmpty ? nil : screenClass)
         }
     }
 
@@ -231,19 +251,34 @@ open class FirebaseTracker: Tracker {
 
         var parameterMapper: ParameterMapper?
         var configFileName: String?
+        var analytics: FirebaseAnalyticsEnabler?
 
         public init(context: UIApplication, configFileName: String? = nil) {
             super.init(context: context, key: nil)
             self.configFileName = configFileName
         }
 
+        /// Set a custom parameter mapper. A MappingPlan is compiled once when the tracker is built,
+        /// other mappers are called for each event.
+        ///
+        /// - Parameter mapper: Parameter mapper
+        /// - Returns: Builder so that it can be chained.
         open func add(mapper: ParameterMapper) -> FirebaseBuilder {
             parameterMapper = mapper
             return self
         }
 
+        /// Set a stand-in for FirebaseAnalytics. Firebase is not configured when it is set.
+        ///
+        /// - Parameter analytics: The stand-in
+        /// - Returns: Builder so that it can be chained.
+        open func set(analytics: FirebaseAnalyticsEnabler) -> FirebaseBuilder {
+            self.analytics = analytics
+            return self
+        }
+
         open override func build() -> FirebaseTracker {
-            return FirebaseTracker(builder: self)
+            return measured { FirebaseTracker(builder: self) }
         }
     }
 }
@@ -50,7 +50,7 @@ public struct GoogleMapFunction: MapFunction {
 
     public func mapScreenName(parameters: TrackingParameters) -> String? {
 
-        if parameters.eventName.lowercased() == StanwoodAnalytics.TrackingEvent.viewItem.rawValue.lowercased() {
+        if parameters.isEvent(.viewItem) {
             return parameters.name
         }
         return nil
@@ -62,70 +62,313 @@ public struct GoogleMapFunction: MapFunction {
     }
 }
 
+/// A declarative map function. The tracker compiles it once when it is built, instead of calling
+/// the map functions for every event.
+///
+/// The default plan maps like GoogleMapFunction: the event name is the category, the name is the action,
+/// the item id is the label, and view item events are screen views named after the name.
+public struct GoogleMappingPlan: MapFunction {
+    /// The field used as the event category.
+    public var category: MappingPlan.Field? {
+        didSet { recompile() }
+    }
+    /// The field used as the event action.
+    public var action: MappingPlan.Field? {
+        didSet { recompile() }
+    }
+    /// The field used as the event label.
+    public var label: MappingPlan.Field? {
+        didSet { recompile() }
+    }
+    /// The field used as the screen name of screen events.
+    public var screenName: MappingPlan.Field? {
+        didSet { recompile() }
+    }
+    /// The event names tracked as screen views, compared ignoring case.
+    public var screenEvents: [String] {
+        didSet { recompile() }
+    }
+    /// The custom dimension of each tracker key. Values other than strings are mapped as their stringValue.
+    public var dimensions: [String: Int] {
+        didSet { recompile() }
+    }
+
+    /// The plan compiled when it was made or changed, so mapping with the plan itself does not compile it.
+    private var compiled: CompiledGoogleMappingPlan?
+
+    /// Init the plan. A nil category, action or label means the event is not sent.
+    ///
+    /// - Parameters:
+    ///   - category: The field used as the event category.
+    ///   - action: The field used as the event action.
+    ///   - label: The field used as the event label.
+    ///   - screenName: The field used as the screen name of screen events.
+    ///   - screenEvents: The event names tracked as screen views.
+    ///   - dimensions: The custom dimension of each tracker key.
+    public init(category: MappingPlan.Field? = .eventName,
+                action: MappingPlan.Field? = .name,
+                label: MappingPlan.Field? = .itemId,
+                screenName: MappingPlan.Field? = .name,
+                screenEvents: [String] = [StanwoodAnalytics.TrackingEvent.viewItem.rawValue],
+                dimensions: [String: Int] = [:]) {
+        self.category = category
+        self.action = action
+        self.label = label
+        self.screenName = screenName
+        self.screenEvents = screenEvents
+        self.dimensions = dimensions
+        recompile()
+    }
+
+    /// The compiled plan. It is compiled once for each change of the plan, so every call returns the same instance.
+    ///
+    /// - Returns: The compiled plan.
+    public func compile() -> CompiledGoogleMappingPlan {
+        return compiled ?? CompiledGoogleMappingPlan(plan: self)
+    }
+
+    /// :nodoc:
+    private mutating func recompile() {
+        compiled = CompiledGoogleMappingPlan(plan: self)
+    }
+
+    public func mapCategory(parameters: TrackingParameters) -> String? {
+        return compile().event(for: parameters)?.category
+    }
+
+    public func mapAction(parameters: TrackingParameters) -> String? {
+        return compile().event(for: parameters)?.action
+    }
+
+    public func mapLabel(parameters: TrackingParameters) -> String? {
+        return compile().event(for: parameters)?.label
+    }
+
+    public func mapScreenName(parameters: TrackingParameters) -> String? {
+        return compile().screenName(for: parameters)
+    }
+
+    public func mapKeys(keys: TrackerKeys) -> [Int: String]? {
+        return compile().map(keys: keys)
+    }
+}
+
+/// A GoogleMappingPlan compiled to field indexes and case folded event symbols.
+public final class CompiledGoogleMappingPlan {
+
+    /// :nodoc:
+    private struct Slot {
+        let field: Int
+        let customKey: String?
+
+        init?(_ field: MappingPlan.Field?) {
+            guard let field = field else { return nil }
+            let index = CompiledMappingPlan.index(of: field)
+            self.field = index.0
+            customKey = index.1
+        }
+
+        func value(in parameters: TrackingParameters) -> String? {
+            return CompiledMappingPlan.value(at: field, customKey: customKey, in: parameters)
+        }
+    }
+
+    private let category: Slot?
+    private let action: Slot?
+    private let label: Slot?
+    private let screenName: Slot?
+    private let screenSymbols: [Symbol]
+    private let screenEvents: Set<String>
+    private let dimensions: [(key: String, dimension: Int)]
+
+    /// :nodoc:
+    init(plan: GoogleMappingPlan) {
+        category = Slot(plan.category)
+        action = Slot(plan.action)
+        label = Slot(plan.label)
+        screenName = Slot(plan.screenName)
+        screenSymbols = plan.screenEvents.compactMap { Symbol($0)?.folded }
+        screenEvents = Set(plan.screenEvents.map { $0.lowercased() })
+        dimensions = plan.dimensions.map { (key: $0.key, dimension: $0.value) }
+    }
+
+    /// The screen name, if the event is a screen event.
+    func screenName(for parameters: TrackingParameters) -> String? {
+        guard let screenName = screenName, isScreenEvent(parameters) else { return nil }
+        return screenName.value(in: parameters)
+    }
+
+    /// The category, action and label of the event, or nil if one of them is missing.
+    func event(for parameters: TrackingParameters) -> (category: String, action: String, label: String)? {
+        guard let category = category?.value(in: parameters),
+            let action = action?.value(in: parameters),
+            let label = label?.value(in: parameters) else { return nil }
+        return (category, action, label)
+    }
+
+    /// True if the plan maps keys to custom dimensions.
+    var hasDimensions: Bool {
+        return !dimensions.isEmpty
+    }
+
+    /// The custom dimensions of the keys, or nil if there are none.
+    func map(keys: TrackerKeys) -> [Int: String]? {
+        guard !dimensions.isEmpty else { return nil }
+
+        var mapped = [Int: String](minimumCapacity: dimensions.count)
+        for (key, dimension) in dimensions {
+            if let value = keys.values[key]?.stringValue {
+                mapped[dimension] = value
+            }
+        }
+        return mapped.isEmpty ? nil : mapped
+    }
+
+    /// :nodoc:
+    private func isScreenEvent(_ parameters: TrackingParameters) -> Bool {
+        if let eventSymbol = parameters.eventSymbol {
+            return screenSymbols.contains(eventSymbol.folded)
+        }
+        return screenEvents.contains(parameters.eventName.lowercased())
+    }
+}
+
+/// The functions of GAI used by the tracker.
+///
+/// The tracker calls Google Analytics through this protocol, so that tests and benchmarks can measure the tracker
+/// with a stand-in GAITracker instead of the SDK. Set one with GoogleAnalyticsBuilder.set(googleAnalytics:).
+public protocol GoogleAnalyticsEnabler {
+    func start(trackUncaughtExceptions: Bool, verboseLogging: Bool)
+    func tracker(withTrackingId trackingId: String?) -> GAITracker?
+    func setOptOut(_ optOut: Bool)
+}
+
+/// Forwards to the shared GAI instance.
+struct GoogleAnalyticsSDK: GoogleAnalyticsEnabler {
+
+    func start(trackUncaughtExceptions: Bool, verboseLogging: Bool) {
+        guard let gai = GAI.sharedInstance() else { return }
+        gai.trackUncaughtExceptions = trackUncaughtExceptions
+        if verboseLogging == true {
+            gai.logger.logLevel = GAILogLevel.verbose
+        }
+
+        let tracker = gai.defaultTracker
+        tracker?.set(kGAIAnonymizeIp, value: "1")
+
+        gai.optOut = false
+    }
+
+    func tracker(withTrackingId trackingId: String?) -> GAITracker? {
+        return GAI.sharedInstance()?.tracker(withTrackingId: trackingId)
+    }
+
+    func setOptOut(_ optOut: Bool) {
+        guard let gai = GAI.sharedInstance() else { return }
+        gai.optOut = optOut
+    }
+}
+
 /// GoogleAnalytics Tracker
 open class GoogleAnalyticsTracker: Tracker {
     private var activityTracking: Bool = false
     private var exceptionTracking: Bool = false
     private var adIdCollection: Bool = false
+    let googleAnalytics: GoogleAnalyticsEnabler
 
     /// Map function
     var mapFunction: MapFunction?
+    /// The compiled map function, when the map function is a GoogleMappingPlan.
+    var mappingPlan: CompiledGoogleMappingPlan?
 
     init(builder: GoogleAnalyticsBuilder) {
+        googleAnalytics = builder.googleAnalytics ?? GoogleAnalyticsSDK()
         super.init(builder: builder)
 
         activityTracking = builder.activityTracking
         exceptionTracking = builder.exceptionTrackingEnabled
         adIdCollection = builder.adIdCollection
         mapFunction = builder.mapFunction
+        mappingPlan = (builder.mapFunction as? GoogleMappingPlan)?.compile()
 
         super.checkKey()
 
         if StanwoodAnalytics.trackingEnabled() == true {
-            start()
+            startMeasured()
         }
     }
 
     /// Start the tracking
     open override func start() {
-        guard let gai = GAI.sharedInstance() else { return }
-        gai.trackUncaughtExceptions = exceptionTracking
-        if loggingEnabled == true {
-            gai.logger.logLevel = GAILogLevel.verbose
-        }
+        googleAnalytics.start(trackUncaughtExceptions: exceptionTracking, verboseLogging: loggingEnabled)
+    }
 
-        let tracker = gai.defaultTracker
-        tracker?.set(kGAIAnonymizeIp, value: "1")
+    /// Keys are only tracked when the map function maps them to custom dimensions.
+    open override var capabilities: Capabilities {
+        if let mappingPlan = mappingPlan, !mappingPlan.hasDimensions {
+            return [.events, .errors, .consent]
+        }
+        return .all
+    }
 
-        gai.optOut = false
+    /// The shared GAI instance is set up and opted out on the main thread.
+    open override var mainThreadCalls: Set<TrackerCall> {
+        return [.start, .setTracking]
     }
 
     /// Enable tracking. This method employs the opt-out flag in the framework.
     ///
     /// - Parameter enabled: enable flag
     open override func setTracking(enabled: Bool) {
-        guard let gai = GAI.sharedInstance() else { return }
-        gai.optOut = !enabled
+        googleAnalytics.setOptOut(!enabled)
     }
 
     /// Track the parameters. If a map function is defined and screen name if not nil, it calls
     ///
     /// - Parameter trackingParameters: Tracking parameters struct
     open override func track(trackingParameters: TrackingParameters) {
+        guard let tracker = googleAnalytics.tracker(withTrackingId: key) else { return }
+        track(trackingParameters: trackingParameters, on: tracker)
+    }
+
+    /// Track a batch of events. The GA tracker is looked up once for the whole batch.
+    ///
+    /// - Parameter batch: Prepared events
+    open override func track(batch: [PreparedEvent]) {
+        guard let tracker = googleAnalytics.tracker(withTrackingId: key) else { return }
+        for event in batch {
+            track(trackingParameters: event.parameters, on: tracker)
+        }
+    }
+
+    /// :nodoc:
+    fileprivate func track(trackingParameters: TrackingParameters, on tracker: GAITracker) {
+        if let mappingPlan = mappingPlan {
+            if let screenName = mappingPlan.screenName(for: trackingParameters) {
+                trackScreenView(screenName, on: tracker)
+            } else if let event = mappingPlan.event(for: trackingParameters) {
+                trackEvent(category: event.category, action: event.action, label: event.label, on: tracker)
+            }
+            return
+        }
+
         if let screenName = mapFunction?.mapScreenName(parameters: trackingParameters) {
-            trackScreenView(screenName)
+            trackScreenView(screenName, on: tracker)
         } else {
-            trackEvent(with: trackingParameters)
+            trackEvent(with: trackingParameters, on: tracker)
         }
     }
 
     /// :nodoc:
-    fileprivate func trackEvent(with parameters: TrackingParameters) {
+    fileprivate func trackEvent(with parameters: TrackingParameters, on tracker: GAITracker) {
         guard let action = mapFunction?.mapAction(parameters: parameters) else { return }
         guard let label = mapFunction?.mapLabel(parameters: parameters) else { return }
         guard let category = mapFunction?.mapCategory(parameters: parameters) else { return }
-        guard let tracker = GAI.sharedInstance().tracker(withTrackingId: key) else { return }
+        trackEvent(category: category, action: action, label: label, on: tracker)
+    }
 
+    /// :nodoc:
+    fileprivate func trackEvent(category: String, action: String, label: String, on tracker: GAITracker) {
         if let builder = GAIDictionaryBuilder.createEvent(withCategory: category, action: action, label: label, value: 0),
             let build = (builder.build() as NSDictionary) as? [AnyHashable: Any] {
             tracker.send(build)
@@ -133,22 +376,21 @@ open class GoogleAnalyticsTracker: Tracker {
     }
 
     /// :nodoc:
-    fileprivate func trackScreenView(_ screenName: String) {
-        let tracker = GAI.sharedInstance().tracker(withTrackingId: key)
-        tracker?.set(kGAIScreenName, value: screenName)
+    fileprivate func trackScreenView(_ screenName: String, on tracker: GAITracker) {
+        tracker.set(kGAIScreenName, value: screenName)
 
         // Adding custom dimensions
-        tracker?.set(GAIFields.customDimension(for: 1), value: screenName)
+        tracker.set(GAIFields.customDimension(for: 1), value: screenName)
 
         if let builder = GAIDictionaryBuilder.createScreenView(), let build = (builder.build() as NSDictionary) as? [AnyHashable: Any] {
-            tracker?.send(build)
+            tracker.send(build)
         }
 
         // Sending custom dimentions
         if let builder = GAIDictionaryBuilder.createScreenView() {
             builder.set(screenName, forKey: GAIFields.customDimension(for: 1))
             let parameters = builder.build() as! [AnyHashable: Any]
-            tracker?.send(parameters)
+            tracker.send(parameters)
         }
     }
 
@@ -159,20 +401,27 @@ open class GoogleAnalyticsTracker: Tracker {
         let description = error.localizedDescription
         let gaiData = GAIDictionaryBuilder.createException(withDescription: description,
                                                            withFatal: false)
-        let tracker = GAI.sharedInstance().tracker(withTrackingId: key)
+        let tracker = googleAnalytics.tracker(withTrackingId: key)
         tracker?.send(gaiData?.build() as! [AnyHashable: Any])
     }
 
     /// Track custom keys
     ///
     /// It is necessary to add a custom mapper for this to work, and implement the mapKeys function, because the default is nil.
+    /// With a GoogleMappingPlan, set the dimensions of the plan instead.
     ///
     /// The implementation here requires [Int:String] as the Int is a custom dimention parameter in GA.
     ///
     /// - Parameter trackerKeys: tracker keys struct
     open override func track(trackerKeys: TrackerKeys) {
-        guard let mapped = self.mapFunction?.mapKeys(keys: trackerKeys) else { return }
-        let tracker = GAI.sharedInstance().tracker(withTrackingId: key)
+        let mappedKeys: [Int: String]?
+        if let mappingPlan = mappingPlan {
+            mappedKeys = mappingPlan.map(keys: trackerKeys)
+        } else {
+            mappedKeys = mapFunction?.mapKeys(keys: trackerKeys)
+        }
+        guard let mapped = mappedKeys else { return }
+        let tracker = googleAnalytics.tracker(withTrackingId: key)
 
         for (key, value) in mapped {
             let custom = GAIFields.customDimension(for: UInt(key))
@@ -188,17 +437,17 @@ open class GoogleAnalyticsTracker: Tracker {
     ///
     /// - Parameter clientID: Clinet Id.
     func set(clientID: String) {
-        let tracker = GAI.sharedInstance().tracker(withTrackingId: key)
+        let tracker = googleAnalytics.tracker(withTrackingId: key)
         tracker?.set(kGAIUserId, value: clientID)
     }
 
     /// Builder
     open class GoogleAnalyticsBuilder: Tracker.Builder {
         var uiEventLogging = false
-        var sampleRate: Int = 0
         var activityTracking: Bool = false
         var adIdCollection: Bool = false
-        var mapFunction: MapFunction = GoogleMapFunction()
+        var mapFunction: MapFunction = GoogleMappingPlan()
+        var googleAnalytics: GoogleAnalyticsEnabler?
 
         /// Init the builder
         ///
@@ -210,10 +459,21 @@ open class GoogleAnalyticsTracker: Tracker {
         }
 
         open override func build() -> GoogleAnalyticsTracker {
-            return GoogleAnalyticsTracker(builder: self)
+            return measured { GoogleAnalyticsTracker(builder: self) }
+        }
+
+        /// Set the percentage of events sent to Google Analytics. It sets the default rate of the tracker,
+        /// the same as setSampleRate(_:forEvent:) with the percentage divided by 100.
+        ///
+        /// - Parameter percent: A percentage between 0 and 100.
+        /// - Returns: Builder so that it can be chained.
+        open func setGoogleSampleRate(percent: Int) -> GoogleAnalyticsBuilder {
+            sampleRates.set(Double(min(max(percent, 0), 100)) / 100, for: nil)
+            return self
         }
 
-        /// Set the Mapfunction
+        /// Set the Mapfunction. A GoogleMappingPlan is compiled once when the tracker is built,
+        /// other map functions are called for each event.
         ///
         /// - Parameter mapFunction: custom map function
         /// - Returns: Builder so that it can be chained.
@@ -222,6 +482,15 @@ open class GoogleAnalyticsTracker: Tracker {
             return self
         }
 
+        /// Set a stand-in for Google Analytics.
+        ///
+        /// - Parameter googleAnalytics: The stand-in
+        /// - Returns: Builder so that it can be chained.
+        open func set(googleAnalytics: GoogleAnalyticsEnabler) -> GoogleAnalyticsBuilder {
+            self.googleAnalytics = googleAnalytics
+            return self
+        }
+
         /// Enable UI event logging.
         ///
         /// - Parameter enabled: Set UI event logging.
@@ -26,77 +26,130 @@
 import Foundation
 import Mixpanel
 
+/// The functions of Mixpanel used by the tracker.
+///
+/// The tracker calls Mixpanel through this protocol, so that tests and benchmarks can measure the tracker with
+/// a stand-in instead of the SDK. Set one with MixpanelBuilder.set(mixpanel:).
+public protocol MixpanelEnabler {
+    func initialize(token: String, loggingEnabled: Bool)
+    func track(event: String, properties: Properties)
+    func identify(distinctId: String)
+    func setPeople(property: String, to value: MixpanelType)
+    func setTracking(enabled: Bool)
+    func track<Events: Sequence>(events: Events) where Events.Element == (event: String, properties: Properties)
+}
+
+extension MixpanelEnabler {
+
+    /// Tracks the events one by one.
+    public func track<Events: Sequence>(events: Events) where Events.Element == (event: String, properties: Properties) {
+        for (event, properties) in events {
+            track(event: event, properties: properties)
+        }
+    }
+}
+
+/// Forwards to the main Mixpanel instance.
+struct MixpanelSDK: MixpanelEnabler {
+
+    func initialize(token: String, loggingEnabled: Bool) {
+        Mixpanel.initialize(token: token)
+        Mixpanel.mainInstance().loggingEnabled = loggingEnabled
+    }
+
+    func track(event: String, properties: Properties) {
+        Mixpanel.mainInstance().track(event: event, properties: properties)
+    }
+
+    /// Looks up the main instance once for all the events.
+    func track<Events: Sequence>(events: Events) where Events.Element == (event: String, properties: Properties) {
+        let mixpanel = Mixpanel.mainInstance()
+        for (event, properties) in events {
+            mixpanel.track(event: event, properties: properties)
+        }
+    }
+
+    func identify(distinctId: String) {
+        Mixpanel.mainInstance().identify(distinctId: distinctId)
+    }
+
+    func setPeople(property: String, to value: MixpanelType) {
+        Mixpanel.mainInstance().people.set(property: property, to: value)
+    }
+
+    func setTracking(enabled: Bool) {
+        let mixpanel = Mixpanel.mainInstance()
+        mixpanel.loggingEnabled = enabled
+
+        if enabled == true {
+            mixpanel.optInTracking()
+        } else {
+            mixpanel.optOutTracking()
+        }
+    }
+}
+
 /// Mixpanel Tracker
 open class MixpanelTracker: Tracker {
 
     var parameterMapper: ParameterMapper?
+    let mixpanel: MixpanelEnabler
 
     /// Init with the builder.
     ///
     /// - Parameter builder: Builder
     init(builder: MixpanelBuilder) {
+        mixpanel = builder.mixpanel ?? MixpanelSDK()
         super.init(builder: builder)
 
         super.checkKey()
 
         if StanwoodAnalytics.trackingEnabled() == true {
-            start()
+            startMeasured()
         }
     }
 
     /// Start the tracking. Calls Mixpanel initialise. Logging is enabled.
     open override func start() {
-        Mixpanel.initialize(token: key!)
-        Mixpanel.mainInstance().loggingEnabled = loggingEnabled
+        mixpanel.initialize(token: key!, loggingEnabled: loggingEnabled)
+    }
+
+    /// Errors are not tracked.
+    open override var capabilities: Capabilities {
+        return [.events, .keys, .screenViews, .consent]
+    }
+
+    /// Mixpanel is initialised, opted in and opted out on the main thread.
+    open override var mainThreadCalls: Set<TrackerCall> {
+        return [.start, .setTracking]
     }
 
     /// Tracks all the non-nil properties under event name.
     ///
     /// - Parameter trackingParameters: Tracking parameters struct
     open override func track(trackingParameters: TrackingParameters) {
+        track(event: PreparedEvent(trackingParameters))
+    }
 
-        var properties: [String: String] = [:]
-        properties["EventName"] = trackingParameters.eventName
-
-        if let name = trackingParameters.name {
-            properties["Name"] = name
-        }
-
-        if let itemId = trackingParameters.itemId {
-            properties["ItemId"] = itemId
-        }
-
-        if let contentType = trackingParameters.contentType {
-            properties["ContentType"] = contentType
-        }
-
-        if let category = trackingParameters.category {
-            properties["Category"] = category
-        }
-
-        if let description = trackingParameters.description {
-            properties["Description"] = description
-        }
-
-        trackingParameters.customParameters.forEach { arg in
-            let (key, value) = arg
-            properties[key] = value as? String
-        }
+    /// Tracks the properties of the prepared event, which are shared with the other trackers.
+    ///
+    /// - Parameter event: Prepared event
+    open override func track(event: PreparedEvent) {
+        mixpanel.track(event: event.parameters.eventName, properties: event.properties)
+    }
 
-        Mixpanel.mainInstance().track(event: trackingParameters.eventName, properties: properties)
+    /// Tracks a batch of events, looking up the Mixpanel instance once for the batch.
+    ///
+    /// - Parameter batch: Prepared events
+    open override func track(batch: [PreparedEvent]) {
+        mixpanel.track(events: batch.lazy.map { (event: $0.parameters.eventName, properties: $0.properties as Properties) })
     }
 
     /// Set the opt-in or opt-out tracking in the framework.
     ///
     /// - Parameter enabled: Enable tracking.
     open override func setTracking(enabled: Bool) {
-        Mixpanel.mainInstance().loggingEnabled = enabled
-
-        if enabled == true {
-            Mixpanel.mainInstance().optInTracking()
-        } else {
-            Mixpanel.mainInstance().optOutTracking()
-        }
+        mixpanel.setTracking(enabled: enabled)
     }
 
     /// Track error is not implemented for this framework.
@@ -113,33 +166,50 @@ open class MixpanelTracker: Tracker {
     /// - Parameter trackerKeys: Tracker keys struct
     open override func track(trackerKeys: TrackerKeys) {
 
-        for (key, value) in trackerKeys.customKeys {
+        for (key, value) in trackerKeys.values {
             if key == StanwoodAnalytics.Keys.screenName {
-                if let screenName = value as? String {
-                    Mixpanel.mainInstance().track(event: key, properties: [key: screenName])
+                if case .string(let screenName) = value {
+                    mixpanel.track(event: key, properties: [key: screenName])
                 }
             } else if key == StanwoodAnalytics.Keys.identifier {
-                if let userId = value as? String {
-                    Mixpanel.mainInstance().identify(distinctId: userId)
+                if case .string(let userId) = value {
+                    mixpanel.identify(distinctId: userId)
                 }
             } else if key == StanwoodAnalytics.Keys.email {
-                if let userEmail = value as? String {
-                    Mixpanel.mainInstance().people.set(property: "$email", to: userEmail)
+                if case .string(let userEmail) = value {
+                    mixpanel.setPeople(property: "$email", to: userEmail)
                 }
+            } else if let mixpanelValue = mixpanelValue(of: value) {
+                mixpanel.setPeople(property: key, to: mixpanelValue)
             } else {
-                if let anyValue = value as? MixpanelType {
-                    Mixpanel.mainInstance().people.set(property: key, to: anyValue)
-                } else {
-                    print("StanwoodAnalytics Error: Unsupported value for key (" + String(describing: key) + ") in TrackerKeys")
-                }
+                print("StanwoodAnalytics Error: Unsupported value for key (" + key + ") in TrackerKeys")
             }
         }
     }
 
+    /// :nodoc:
+    private func mixpanelValue(of value: TrackingValue) -> MixpanelType? {
+        switch value {
+        case .bool(let bool):
+            return bool
+        case .int(let int):
+            return int
+        case .double(let double):
+            return double
+        case .string(let string):
+            return string
+        case .date(let date):
+            return date
+        case .other(let other):
+            return other as? MixpanelType
+        }
+    }
+
     /// Builder
     open class MixpanelBuilder: Tracker.Builder {
 
         var parameterMapper: ParameterMapper?
+        var mixpanel: MixpanelEnabler?
 
         public override init(context: UIApplication, key: String?) {
             super.init(context: context, key: key)
@@ -154,11 +224,20 @@ open class MixpanelTracker: Tracker {
             return self
         }
 
+        /// Set a stand-in for Mixpanel.
+        ///
+        /// - Parameter mixpanel: The stand-in
+        /// - Returns: Builder so that it can be chained.
+        open func set(mixpanel: MixpanelEnabler) -> MixpanelBuilder {
+            self.mixpanel = mixpanel
+            return self
+        }
+
         /// Build the tracker
         ///
         /// - Returns: The tracker with the configuration.
         open override func build() -> MixpanelTracker {
-            return MixpanelTracker(builder: self)
+            return measured { MixpanelTracker(builder: self) }
         }
     }
 }
@@ -25,29 +25,74 @@
 
 import Foundation
 
+/// The functions of TestFairy used by the tracker.
+///
+/// The tracker calls TestFairy through this protocol, so that tests and benchmarks can measure the tracker with
+/// a stand-in instead of the SDK. Set one with TestFairyBuilder.set(testFairy:).
+public protocol TestFairyEnabler {
+    func begin(_ appToken: String?)
+    func log(_ message: String)
+    func setUserId(_ userId: String)
+}
+
+/// Forwards to TestFairy.
+struct TestFairySDK: TestFairyEnabler {
+
+    func begin(_ appToken: String?) {
+        TestFairy.begin(appToken)
+    }
+
+    func log(_ message: String) {
+        TestFairy.log(message)
+    }
+
+    func setUserId(_ userId: String) {
+        TestFairy.setUserId(userId)
+    }
+}
+
 /// TestFairy Tracker
 open class TestFairyTracker: Tracker {
 
+    let testFairy: TestFairyEnabler
+
     init(builder: TestFairyBuilder) {
+        testFairy = builder.testFairy ?? TestFairySDK()
         super.init(builder: builder)
 
         super.checkKey()
 
         if StanwoodAnalytics.trackingEnabled() == true {
-            start()
+            startMeasured()
         }
     }
 
     open override func start() {
-        TestFairy.begin(key)
+        testFairy.begin(key)
+    }
+
+    /// Events and the user identifier key. Errors and setTracking are not implemented.
+    open override var capabilities: Capabilities {
+        return [.events, .keys]
+    }
+
+    /// TestFairy begins its session and screen recording on the main thread.
+    open override var mainThreadCalls: Set<TrackerCall> {
+        return [.start]
     }
 
     /// Track event. It records eventName, name and itemId.
     ///
     /// - Parameter trackingParameters: TrackingParameters struct
     open override func track(trackingParameters: TrackingParameters) {
-        let message = "Event: \(String(describing: trackingParameters.eventName)) Name: \(String(describing: trackingParameters.name)) ItemId: \(String(describing: trackingParameters.itemId))"
-        TestFairy.log(message)
+        track(event: PreparedEvent(trackingParameters))
+    }
+
+    /// Track a prepared event. The log message is shared with the other trackers.
+    ///
+    /// - Parameter event: Prepared event
+    open override func track(event: PreparedEvent) {
+        testFairy.log(event.logMessage)
     }
 
     /// Set Tracking - Not implemented.
@@ -71,23 +116,31 @@ open class TestFairyTracker: Tracker {
     /// - Parameter trackerKeys: TrackerKeys struct
     open override func track(trackerKeys: TrackerKeys) {
 
-        for (key, value) in trackerKeys.customKeys where key == StanwoodAnalytics.Keys.identifier {
-            if let userId = value as? String {
-                TestFairy.setUserId(userId)
-            }
+        if let userId = trackerKeys.values[StanwoodAnalytics.Keys.identifier]?.string {
+            testFairy.setUserId(userId)
         }
     }   
 
     /// Buiulder for the tracker.
     open class TestFairyBuilder: Tracker.Builder {
         var uiEventLogging = false
+        var testFairy: TestFairyEnabler?
 
         public override init(context: UIApplication, key: String?) {
             super.init(context: context, key: key)
         }
 
         open override func build() -> TestFairyTracker {
-            return TestFairyTracker(builder: self)
+            return measured { TestFairyTracker(builder: self) }
+        }
+
+        /// Set a stand-in for TestFairy.
+        ///
+        /// - Parameter testFairy: The stand-in
+        /// - Returns: Builder so that it can be chained.
+        open func set(testFairy: TestFairyEnabler) -> TestFairyBuilder {
+            self.testFairy = testFairy
+            return self
         }
 
         /// Set UI event logging. This is not currently implemented.